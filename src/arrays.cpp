@@ -0,0 +1,298 @@
+#include "arrays.hpp"
+#include "interpreter.hpp"
+#include <stdlib.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+//------------------------------------------------------
+//kernels:
+//
+//reductions keep two vector accumulators to hide the latency of the adds, so they
+//don't sum in the order a loop over the elements would, and may round differently
+
+static double kernel_sum(const double* x, size_t n)
+{
+    double total = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    for(; i + 4 <= n; i += 4)
+    {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(x + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(x + i + 2));
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    total = lanes[0] + lanes[1];
+#endif
+    for(; i < n; i++)
+        total += x[i];
+    return total;
+}
+
+static double kernel_dot(const double* x, const double* y, size_t n)
+{
+    double total = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    for(; i + 4 <= n; i += 4)
+    {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    total = lanes[0] + lanes[1];
+#endif
+    for(; i < n; i++)
+        total += x[i] * y[i];
+    return total;
+}
+
+//the least (or with MAX the greatest) of n > 0 elements. nan if any element is nan,
+//like the other reductions, which the vector min and max don't do on their own
+template<bool MAX>
+static double kernel_extreme(const double* x, size_t n)
+{
+    double best = x[0];
+    bool nan = false;
+    size_t i = 0;
+#if defined(__SSE2__)
+    if(n >= 2)
+    {
+        __m128d acc = _mm_loadu_pd(x);
+        __m128d nans = _mm_cmpunord_pd(acc, acc);
+        for(i = 2; i + 2 <= n; i += 2)
+        {
+            __m128d block = _mm_loadu_pd(x + i);
+            nans = _mm_or_pd(nans, _mm_cmpunord_pd(block, block));
+            acc = MAX ? _mm_max_pd(acc, block) : _mm_min_pd(acc, block);
+        }
+
+        double lanes[2];
+        _mm_storeu_pd(lanes, acc);
+        best = (MAX ? lanes[1] > lanes[0] : lanes[1] < lanes[0]) ? lanes[1] : lanes[0];
+        nan = _mm_movemask_pd(nans) != 0;
+    }
+#endif
+    for(; i < n; i++)
+    {
+        nan |= x[i] != x[i];
+        if(MAX ? x[i] > best : x[i] < best)
+            best = x[i];
+    }
+    return nan ? NAN : best;
+}
+
+template<Operator OP>
+static inline double apply_scalar(double a, double b)
+{
+    switch(OP)
+    {
+    case ADD:  return a + b;
+    case SUB:  return a - b;
+    case MULT: return a * b;
+    default:   return a / b;
+    }
+}
+
+#if defined(__SSE2__)
+template<Operator OP>
+static inline __m128d apply_pair(__m128d a, __m128d b)
+{
+    switch(OP)
+    {
+    case ADD:  return _mm_add_pd(a, b);
+    case SUB:  return _mm_sub_pd(a, b);
+    case MULT: return _mm_mul_pd(a, b);
+    default:   return _mm_div_pd(a, b);
+    }
+}
+#endif
+
+//out[i] = l[i] OP r[i], a scalar side being read from its first element every time
+template<Operator OP, bool L_SCALAR, bool R_SCALAR>
+static void kernel_map(const double* l, const double* r, double* out, size_t n)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for(; i + 2 <= n; i += 2)
+    {
+        __m128d a = L_SCALAR ? _mm_set1_pd(l[0]) : _mm_loadu_pd(l + i);
+        __m128d b = R_SCALAR ? _mm_set1_pd(r[0]) : _mm_loadu_pd(r + i);
+        _mm_storeu_pd(out + i, apply_pair<OP>(a, b));
+    }
+#endif
+    for(; i < n; i++)
+        out[i] = apply_scalar<OP>(l[L_SCALAR ? 0 : i], r[R_SCALAR ? 0 : i]);
+}
+
+template<Operator OP>
+static void map_elements(const double* l, bool lScalar, const double* r, bool rScalar, double* out, size_t n)
+{
+    if(lScalar)
+        kernel_map<OP, true, false>(l, r, out, n);
+    else if(rScalar)
+        kernel_map<OP, false, true>(l, r, out, n);
+    else
+        kernel_map<OP, false, false>(l, r, out, n);
+}
+
+//------------------------------------------------------
+//builtins:
+
+static void expect_array(const Builtin* builtin, Value value, int32_t line, int32_t charIdx)
+{
+    if(!value.is_array())
+        throw new RuntimeErrorInvalidArgument(builtin->name, line, charIdx);
+}
+
+static Value builtin_literal(const Builtin* builtin, const Value* args, int32_t numArgs, int32_t line, int32_t charIdx)
+{
+    for(int32_t i = 0; i < numArgs; i++)
+        if(args[i].is_array())
+            throw new RuntimeErrorInvalidArgument(builtin->name, line, charIdx);
+
+    Value array = Value::new_array(numArgs);
+    double* elements = array.array_elements();
+    for(int32_t i = 0; i < numArgs; i++)
+        elements[i] = args[i].get_scalar();
+    return array;
+}
+
+static Value builtin_index(const Builtin* builtin, const Value* args, int32_t, int32_t line, int32_t charIdx)
+{
+    expect_array(builtin, args[0], line, charIdx);
+    if(!args[1].is_int() || args[1].as_int() < 0 || (uint64_t)args[1].as_int() >= args[0].array_length())
+        throw new RuntimeErrorInvalidArgument(builtin->name, line, charIdx);
+
+    return Value(args[0].array_elements()[args[1].as_int()]);
+}
+
+static Value builtin_len(const Builtin* builtin, const Value* args, int32_t, int32_t line, int32_t charIdx)
+{
+    expect_array(builtin, args[0], line, charIdx);
+    return Value((int64_t)args[0].array_length());
+}
+
+static Value builtin_sum(const Builtin* builtin, const Value* args, int32_t, int32_t line, int32_t charIdx)
+{
+    expect_array(builtin, args[0], line, charIdx);
+    return Value(kernel_sum(args[0].array_elements(), args[0].array_length()));
+}
+
+static Value builtin_dot(const Builtin* builtin, const Value* args, int32_t, int32_t line, int32_t charIdx)
+{
+    expect_array(builtin, args[0], line, charIdx);
+    expect_array(builtin, args[1], line, charIdx);
+    if(args[0].array_length() != args[1].array_length())
+        throw new RuntimeErrorArrayLengths(args[0].array_length(), args[1].array_length(), line, charIdx);
+
+    return Value(kernel_dot(args[0].array_elements(), args[1].array_elements(), args[0].array_length()));
+}
+
+template<bool MAX>
+static Value builtin_extreme(const Builtin* builtin, const Value* args, int32_t, int32_t line, int32_t charIdx)
+{
+    expect_array(builtin, args[0], line, charIdx);
+    if(args[0].array_length() == 0)
+        throw new RuntimeErrorInvalidArgument(builtin->name, line, charIdx);
+
+    return Value(kernel_extreme<MAX>(args[0].array_elements(), args[0].array_length()));
+}
+
+static const Builtin BUILTINS[] = {
+    {ARRAY_LITERAL_NAME, -1, Value::ARRAY, builtin_literal},
+    {ARRAY_INDEX_NAME,    2, Value::FLOAT, builtin_index},
+    {"len",               1, Value::INT,   builtin_len},
+    {"sum",               1, Value::FLOAT, builtin_sum},
+    {"dot",               2, Value::FLOAT, builtin_dot},
+    {"min",               1, Value::FLOAT, builtin_extreme<false>},
+    {"max",               1, Value::FLOAT, builtin_extreme<true>}
+};
+
+//------------------------------------------------------
+//non-static func definitions:
+
+const Builtin* find_builtin(const char* name)
+{
+    for(const Builtin& builtin : BUILTINS)
+        if(strcmp(builtin.name, name) == 0)
+            return &builtin;
+
+    return nullptr;
+}
+
+Value call_builtin(const Builtin* builtin, const Value* args, int32_t numArgs, int32_t line, int32_t charIdx)
+{
+    if(builtin->numParams >= 0 && numArgs != builtin->numParams)
+        throw new RuntimeErrorIncorrectNumArgs(builtin->name, numArgs, line, charIdx);
+
+    return builtin->fn(builtin, args, numArgs, line, charIdx);
+}
+
+Value array_operator(Operator op, Value l, Value r, int32_t line, int32_t charIdx)
+{
+    if(op != ADD && op != SUB && op != MULT && op != DIV)
+        throw new RuntimeErrorInvalidOperator(line, charIdx);
+    if(l.is_array() && r.is_array() && l.array_length() != r.array_length())
+        throw new RuntimeErrorArrayLengths(l.array_length(), r.array_length(), line, charIdx);
+
+    const size_t length = l.is_array() ? l.array_length() : r.array_length();
+    const double lScalar = l.is_array() ? 0 : l.get_scalar();
+    const double rScalar = r.is_array() ? 0 : r.get_scalar();
+
+    //the operands are only looked up once the result is made, since making it may move them
+    Value result = Value::new_array(length);
+    const double* a = l.is_array() ? l.array_elements() : &lScalar;
+    const double* b = r.is_array() ? r.array_elements() : &rScalar;
+    double* out = result.array_elements();
+
+    switch(op)
+    {
+    case ADD:
+        map_elements<ADD>(a, !l.is_array(), b, !r.is_array(), out, length);
+        break;
+    case SUB:
+        map_elements<SUB>(a, !l.is_array(), b, !r.is_array(), out, length);
+        break;
+    case MULT:
+        map_elements<MULT>(a, !l.is_array(), b, !r.is_array(), out, length);
+        break;
+    default:
+        map_elements<DIV>(a, !l.is_array(), b, !r.is_array(), out, length);
+        break;
+    }
+    return result;
+}
+
+bool parse_array(const std::string& text, Value& array)
+{
+    if(text.size() < 2 || text.front() != '[' || text.back() != ']')
+        return false;
+
+    std::vector<double> elements;
+    const char* cur = text.c_str() + 1;
+    const char* end = text.c_str() + text.size() - 1;
+    while(cur < end)
+    {
+        char* last;
+        elements.push_back(strtod(cur, &last));
+        if(last == cur || last > end || (last < end && *last != ','))
+            return false;
+
+        cur = last < end ? last + 1 : last;
+        if(cur == end && last < end) //trailing comma
+            return false;
+    }
+
+    array = Value::new_array(elements.size());
+    std::copy(elements.begin(), elements.end(), array.array_elements());
+    return true;
+}
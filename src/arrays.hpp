@@ -0,0 +1,42 @@
+#ifndef OPAL_ARRAYS_H
+#define OPAL_ARRAYS_H
+
+#include "syntax.hpp"
+#include "value.hpp"
+#include <string>
+
+//------------------------------------------------------
+//numeric arrays:
+//
+//arrays hold doubles, ints being converted as they're stored. they're made by literals,
+//"[1, 2.5, n]", by the elementwise operators and by main's args, and read by indexing,
+//"xs[i]", and the builtins below. the kernels behind them work on 2 doubles at a time
+//where SSE2 is available, with a scalar tail
+
+//callable by name from any program that doesn't define a function of the same name
+struct Builtin
+{
+    const char* name;
+    int32_t numParams; //-1 for any number
+    Value::Type result; //of every call that doesn't throw
+    Value (*fn)(const Builtin* builtin, const Value* args, int32_t numArgs, int32_t line, int32_t charIdx);
+};
+
+//names the parser gives array literals and indexing, which no function can have
+constexpr const char* ARRAY_LITERAL_NAME = "[]";
+constexpr const char* ARRAY_INDEX_NAME = "[i]";
+
+//returns nullptr if no builtin has the given name
+const Builtin* find_builtin(const char* name);
+//throws RuntimeErrorIncorrectNumArgs if numArgs doesn't fit the builtin
+Value call_builtin(const Builtin* builtin, const Value* args, int32_t numArgs, int32_t line, int32_t charIdx);
+
+//applies op to l and r, at least one of which is an array. + - * / are applied
+//elementwise, a scalar being paired with every element. anything else throws
+//RuntimeErrorInvalidOperator
+Value array_operator(Operator op, Value l, Value r, int32_t line, int32_t charIdx);
+
+//reads "[1,2.5,3]" into a new array. false if text isn't one
+bool parse_array(const std::string& text, Value& array);
+
+#endif
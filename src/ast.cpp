@@ -0,0 +1,421 @@
+#include "ast.hpp"
+#include <string.h>
+#include <string_view>
+#include <algorithm>
+#include <unordered_set>
+
+//------------------------------------------------------
+//helper func definitions:
+
+//copies the tree under root bottom up with an explicit stack, sharing nodes already copied
+static ExpressionHandle copy_tree(AST& to, AST& from, ExpressionHandle root, std::unordered_map<ExpressionHandle, ExpressionHandle>& copied)
+{
+    std::vector<std::pair<ExpressionHandle, bool>> stack = {{root, false}};
+    while(!stack.empty())
+    {
+        ExpressionHandle handle = stack.back().first;
+        if(copied.count(handle))
+        {
+            stack.pop_back();
+            continue;
+        }
+
+        Expression exp = from.get_exp(handle);
+        if(!stack.back().second) //copy children first
+        {
+            stack.back().second = true;
+            for_each_child(exp, [&](ExpressionHandle& child) { stack.push_back({child, false}); });
+            continue;
+        }
+        stack.pop_back();
+
+        if(exp.type == Expression::FUNCTION)
+        {
+            ExpressionHandle* params = mem_new_array<ExpressionHandle>(MEM_CALL_PARAMS, exp.func.numParams);
+            memcpy(params, exp.func.params, exp.func.numParams * sizeof(ExpressionHandle));
+
+            exp.func.params = params;
+            exp.func.name = copy_identifier(exp.func.name);
+            exp.func.target = -1; //functions are numbered differently in to
+        }
+        else if(exp.type == Expression::VARIABLE)
+            exp.var.name = copy_identifier(exp.var.name);
+
+        for_each_child(exp, [&](ExpressionHandle& child) { child = copied.at(child); });
+        copied[handle] = to.add_exp(exp);
+    }
+
+    return copied.at(root);
+}
+
+//------------------------------------------------------
+//hash-consing:
+
+constexpr ExpressionHandle NOT_INTERNED = SIZE_MAX;
+
+//runtime errors report the position of the node that raised them, so where nodes that
+//can raise one occurred is kept in the relocations of each arm they're merged into
+static bool positional(const Expression& exp)
+{
+    switch(exp.type)
+    {
+    case Expression::OPERATOR:
+        //any operator but otherwise fails on arrays it can't apply to, or of different lengths
+        return exp.op.op != OTHERWISE;
+    case Expression::FUNCTION:
+        return true;
+    case Expression::VARIABLE:
+        return exp.var.slot < 0;
+    default:
+        return false;
+    }
+}
+
+//comparisons and otherwise, the guards that can't fail as conditions
+static bool always_bool(const Expression& exp)
+{
+    return exp.type == Expression::OPERATOR && ((exp.op.op >= EQUALITY && exp.op.op <= LESSEQ) || exp.op.op == OTHERWISE);
+}
+
+static uint64_t float_bits(double val)
+{
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    return bits;
+}
+
+static size_t node_hash(const Expression& exp)
+{
+    size_t hash = exp.type;
+    auto mix = [&](size_t value) { hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2); };
+
+    switch(exp.type)
+    {
+    case Expression::OPERATOR:
+        mix(exp.op.op);
+        mix(exp.op.left);
+        mix(exp.op.right);
+        break;
+    case Expression::FUNCTION:
+        mix(std::hash<std::string_view>()(exp.func.name));
+        for(int32_t i = 0; i < exp.func.numParams; i++)
+            mix(exp.func.params[i]);
+        break;
+    case Expression::VARIABLE:
+        mix(std::hash<std::string_view>()(exp.var.name));
+        mix((size_t)exp.var.slot);
+        break;
+    case Expression::INT_LITERAL:
+        mix((size_t)exp.intLit.val);
+        break;
+    case Expression::FLOAT_LITERAL:
+        mix(float_bits(exp.floatLit.val));
+        break;
+    case Expression::TEMP:
+        mix((size_t)exp.temp.slot);
+        mix(exp.temp.exp);
+        break;
+    }
+    return hash;
+}
+
+static bool same_node(const Expression& a, const Expression& b)
+{
+    if(a.type != b.type)
+        return false;
+
+    switch(a.type)
+    {
+    case Expression::OPERATOR:
+        return a.op.op == b.op.op && a.op.left == b.op.left && a.op.right == b.op.right;
+    case Expression::FUNCTION:
+        return strcmp(a.func.name, b.func.name) == 0 && a.func.numParams == b.func.numParams &&
+               std::equal(a.func.params, a.func.params + a.func.numParams, b.func.params);
+    case Expression::VARIABLE:
+        return a.var.slot == b.var.slot && strcmp(a.var.name, b.var.name) == 0;
+    case Expression::INT_LITERAL:
+        return a.intLit.val == b.intLit.val;
+    case Expression::FLOAT_LITERAL:
+        return float_bits(a.floatLit.val) == float_bits(b.floatLit.val);
+    case Expression::TEMP:
+        return a.temp.slot == b.temp.slot && a.temp.exp == b.temp.exp;
+    }
+    return false;
+}
+
+static bool position_less(const Relocation& a, const Relocation& b)
+{
+    return a.line != b.line ? a.line < b.line : a.charIdx < b.charIdx;
+}
+
+//relocations of an arm are sorted by the position of the shared node
+static bool relocate_in(const RelocationList& relocations, const Arm& arm, int32_t& line, int32_t& charIdx)
+{
+    const Relocation* begin = relocations.data() + arm.firstRelocation;
+    const Relocation* end = begin + arm.numRelocations;
+    const Relocation key = {line, charIdx, 0, 0};
+    const Relocation* found = std::lower_bound(begin, end, key, position_less);
+    if(found == end || found->line != line || found->charIdx != charIdx)
+        return false;
+
+    line = found->armLine;
+    charIdx = found->armCharIdx;
+    return true;
+}
+
+//frees what a node merged into an equal one owned
+static void free_node(Expression& exp)
+{
+    if(exp.type == Expression::FUNCTION)
+    {
+        free_identifier(exp.func.name);
+        mem_delete_array(MEM_CALL_PARAMS, exp.func.params, exp.func.numParams);
+    }
+    else if(exp.type == Expression::VARIABLE)
+        free_identifier(exp.var.name);
+}
+
+//------------------------------------------------------
+//AST member definitions:
+
+size_t AST::find_interned(const Expression& exp)
+{
+    const size_t mask = internTable.size() - 1;
+    for(size_t i = node_hash(exp) & mask;; i = (i + 1) & mask)
+        if(internTable[i] == NOT_INTERNED || same_node(expressionBuf[internTable[i]], exp))
+            return i;
+}
+
+bool AST::relocate(const Arm& arm, int32_t& line, int32_t& charIdx) const
+{
+    return relocate_in(relocations, arm, line, charIdx);
+}
+
+void AST::intern(ExpressionHandle begin, Function* funcs, size_t numFuncs, const RelocationList& armRelocations)
+{
+    //guards that could fail as conditions keep a node of their own, so the error points
+    //at the guard it came from
+    std::unordered_set<ExpressionHandle> ownGuards;
+    for(size_t f = 0; f < numFuncs; f++)
+        for(const auto& arm : funcs[f].map)
+            if(arm.second >= begin && !always_bool(expressionBuf[arm.second]))
+                ownGuards.insert(arm.second);
+
+    //where the nodes that can raise errors occur in each arm, before merging loses it.
+    //arms are walked per path, guard first, which is bounded by the trees they were
+    //parsed from:
+    //----------------
+    struct Occurrence
+    {
+        ExpressionHandle handle;
+        int32_t line;
+        int32_t charIdx;
+    };
+    std::vector<std::vector<Occurrence>> occurrences;
+    std::vector<ExpressionHandle> stack;
+    for(size_t f = 0; f < numFuncs; f++)
+    {
+        for(const Arm& arm : funcs[f].map)
+        {
+            std::vector<Occurrence>& found = occurrences.emplace_back();
+            stack = {arm.first, arm.second};
+            while(!stack.empty())
+            {
+                ExpressionHandle handle = stack.back();
+                stack.pop_back();
+
+                Expression& exp = expressionBuf[handle];
+                if(positional(exp))
+                {
+                    Occurrence occurrence = {handle, exp.line, exp.charIdx};
+                    relocate_in(armRelocations, arm, occurrence.line, occurrence.charIdx);
+                    found.push_back(occurrence);
+                }
+
+                const size_t first = stack.size();
+                for_each_child(exp, [&](ExpressionHandle& child) { stack.push_back(child); });
+                std::reverse(stack.begin() + first, stack.end());
+            }
+        }
+    }
+
+    //merge equal nodes:
+    //----------------
+    std::vector<ExpressionHandle> moved(expressionBuf.size() - begin);
+    ExpressionHandle end = begin;
+    for(ExpressionHandle i = begin; i < expressionBuf.size(); i++)
+    {
+        Expression exp = expressionBuf[i];
+        for_each_child(exp, [&](ExpressionHandle& child)
+        {
+            if(child >= begin)
+                child = moved[child - begin];
+        });
+
+        const bool shared = exp.type != Expression::TEMP && ownGuards.count(i) == 0;
+        size_t slot = 0;
+        if(shared)
+        {
+            if((numInterned + 1) * 2 > internTable.size())
+            {
+                std::vector<ExpressionHandle, TrackedAllocator<ExpressionHandle, MEM_EXPRESSIONS>> old(std::max<size_t>(64, internTable.size() * 2), NOT_INTERNED);
+                old.swap(internTable);
+                for(ExpressionHandle handle : old)
+                    if(handle != NOT_INTERNED)
+                        internTable[find_interned(expressionBuf[handle])] = handle;
+            }
+
+            slot = find_interned(exp);
+            if(internTable[slot] != NOT_INTERNED)
+            {
+                free_node(exp);
+                moved[i - begin] = internTable[slot];
+                continue;
+            }
+        }
+
+        expressionBuf[end] = exp;
+        moved[i - begin] = end;
+        if(shared)
+        {
+            internTable[slot] = end;
+            numInterned++;
+        }
+        end++;
+    }
+    expressionBuf.erase(expressionBuf.begin() + end, expressionBuf.end());
+
+    //relocate arms, keeping the first occurrence of each node that didn't occur where
+    //the node it was merged into is:
+    //----------------
+    size_t a = 0;
+    std::vector<Relocation> armRelocs;
+    for(size_t f = 0; f < numFuncs; f++)
+    {
+        for(Arm& arm : funcs[f].map)
+        {
+            if(arm.first >= begin)
+                arm.first = moved[arm.first - begin];
+            if(arm.second >= begin)
+                arm.second = moved[arm.second - begin];
+
+            armRelocs.clear();
+            for(const Occurrence& occurrence : occurrences[a++])
+            {
+                const ExpressionHandle handle = occurrence.handle >= begin ? moved[occurrence.handle - begin] : occurrence.handle;
+                const Expression& exp = expressionBuf[handle];
+                armRelocs.push_back({exp.line, exp.charIdx, occurrence.line, occurrence.charIdx});
+            }
+            std::stable_sort(armRelocs.begin(), armRelocs.end(), position_less);
+
+            arm.firstRelocation = (uint32_t)relocations.size();
+            for(size_t i = 0; i < armRelocs.size(); i++)
+            {
+                const Relocation& r = armRelocs[i];
+                const bool first = i == 0 || position_less(armRelocs[i - 1], r);
+                if(first && (r.line != r.armLine || r.charIdx != r.armCharIdx))
+                    relocations.push_back(r);
+            }
+            arm.numRelocations = (uint32_t)relocations.size() - arm.firstRelocation;
+        }
+    }
+}
+
+Function* AST::find_function(const std::string& name)
+{
+    auto it = functionIndex.find(name);
+    if(it == functionIndex.end())
+        return nullptr;
+
+    return &functions[it->second];
+}
+
+bool AST::add_function(Function func)
+{
+    if(!functionIndex.emplace(func.name, functions.size()).second)
+        return false;
+
+    functions.push_back(std::move(func));
+    return true;
+}
+
+void AST::merge(AST& other)
+{
+    const ExpressionHandle offset = expressionBuf.size();
+
+    //relocate expressions:
+    //----------------
+    expressionBuf.reserve(expressionBuf.size() + other.expressionBuf.size());
+    for(Expression& exp : other.expressionBuf)
+    {
+        for_each_child(exp, [&](ExpressionHandle& child) { child += offset; });
+        if(exp.type == Expression::FUNCTION)
+            exp.func.target = -1; //functions are numbered differently here
+        expressionBuf.push_back(exp);
+    }
+    other.expressionBuf.clear();
+
+    //relocate tokens of unparsed bodies:
+    //----------------
+    const size_t tokenOffset = tokens.size();
+    tokens.insert(tokens.end(), other.tokens.begin(), other.tokens.end());
+    other.tokens.clear();
+
+    imports.insert(imports.end(), other.imports.begin(), other.imports.end());
+    other.imports.clear();
+
+    //relocate functions:
+    //----------------
+    for(Function& func : other.functions)
+    {
+        if(!func.parsed)
+        {
+            func.bodyBegin += tokenOffset;
+            func.bodyEnd += tokenOffset;
+        }
+
+        for(auto& arm : func.map)
+        {
+            arm.first += offset;
+            arm.second += offset;
+        }
+    }
+    intern(offset, other.functions.data(), other.functions.size(), other.relocations);
+    other.relocations.clear();
+
+    for(Function& func : other.functions)
+        add_function(std::move(func));
+    other.functions.clear();
+    other.functionIndex.clear();
+}
+
+void AST::copy_function(AST& from, const Function& func)
+{
+    Function copy = func;
+    if(!func.parsed)
+    {
+        copy.bodyBegin = tokens.size();
+        for(size_t i = func.bodyBegin; i <= func.bodyEnd; i++)
+        {
+            Token token = from.tokens[i];
+            if(token.type == Token::IDENTIFIER)
+                token.iden = copy_identifier(token.iden);
+
+            tokens.push_back(token);
+        }
+        copy.bodyEnd = tokens.size() - 1;
+    }
+    else
+    {
+        const ExpressionHandle begin = expressionBuf.size();
+        std::unordered_map<ExpressionHandle, ExpressionHandle> copied;
+        for(auto& arm : copy.map)
+        {
+            arm.first = copy_tree(*this, from, arm.first, copied);
+            arm.second = copy_tree(*this, from, arm.second, copied);
+        }
+        intern(begin, &copy, 1, from.relocations);
+    }
+
+    add_function(std::move(copy));
+}
@@ -2,7 +2,11 @@
 #define OPAL_AST_H
 
 #include "syntax.hpp"
+#include "token.hpp"
 #include <vector>
+#include <string>
+#include <unordered_map>
+#include <memory>
 
 typedef size_t ExpressionHandle;
 
@@ -14,7 +18,8 @@ struct Expression
         FUNCTION,
         VARIABLE,
         INT_LITERAL,
-        FLOAT_LITERAL
+        FLOAT_LITERAL,
+        TEMP
     } type;
 
     union
@@ -32,11 +37,13 @@ struct Expression
             char* name;
             int32_t numParams;
             ExpressionHandle* params;
+            int32_t target; //index of the callee in AST::functions, found on the first call. -1 until then
         } func;
 
         struct
         {
             char* name;
+            int32_t slot; //index of the param, resolved when the body is parsed. -1 if unknown
         } var;
 
         struct
@@ -46,8 +53,15 @@ struct Expression
 
         struct
         {
-            float val;
+            double val;
         } floatLit;
+
+        //per call temporary holding exp, evaluated the first time it's needed
+        struct
+        {
+            int32_t slot; //frame index, after the params
+            ExpressionHandle exp;
+        } temp;
     };
 
     int32_t line;
@@ -60,25 +74,155 @@ struct Expression
     }
 };
 
+//calls visit on a reference to every child handle of exp
+template<typename Visit>
+inline void for_each_child(Expression& exp, Visit visit)
+{
+    switch(exp.type)
+    {
+    case Expression::OPERATOR:
+        if(exp.op.op != OTHERWISE)
+        {
+            visit(exp.op.left);
+            visit(exp.op.right);
+        }
+        break;
+    case Expression::FUNCTION:
+        for(int32_t i = 0; i < exp.func.numParams; i++)
+            visit(exp.func.params[i]);
+        break;
+    case Expression::TEMP:
+        visit(exp.temp.exp);
+        break;
+    default:
+        break;
+    }
+}
+
+//where a node shared between arms occurred in one of them, when that isn't where the
+//node itself is. errors raised by the node are reported there
+struct Relocation
+{
+    int32_t line; //of the shared node
+    int32_t charIdx;
+    int32_t armLine; //of its first occurrence in the arm, in the order the arm is evaluated
+    int32_t armCharIdx;
+};
+
+typedef std::vector<Relocation, TrackedAllocator<Relocation, MEM_EXPRESSIONS>> RelocationList;
+
+struct Arm
+{
+    ExpressionHandle first;  //body
+    ExpressionHandle second; //guard
+    uint32_t firstRelocation = 0; //in AST::relocations
+    uint32_t numRelocations = 0;
+};
+
+//times each arm of a function was taken, by function name and arm index
+typedef std::unordered_map<std::string, std::vector<uint64_t>> ArmProfile;
+
+//optimizer passes. per function ones run once its body is parsed, the others once a
+//program is linked, and the hot ones once the tree walker has called a function
+//hotThreshold times
+struct PassOptions
+{
+    bool cse = true;
+    int32_t cloneBudget = 16;    //functions specialize_constant_arguments may add. 0 disables it
+    int32_t hotThreshold = 1000; //0 disables optimize_hot_function
+    bool countArms = false;      //the tree walker counts arm hits into Function::armHits
+    std::shared_ptr<const ArmProfile> armProfile; //arms are reordered by it when set
+};
+
 struct Function
 {
     std::string name;
     std::vector<std::string> params;
-    std::vector<std::pair<ExpressionHandle, ExpressionHandle>> map;
+    std::vector<Arm> map;
+
+    int32_t line;
+    int32_t nameLine = 0; //where the name is, for redefinitions found once parsed
+    int32_t nameCharIdx = 0;
+    int32_t numTemps = 0;
+
+    //token range of the body, between its braces. lazily loaded functions are
+    //only parsed once first called
+    bool parsed = true;
+    bool optimized = false; //load-time passes have run
+    size_t bodyBegin = 0;
+    size_t bodyEnd = 0;
+
+    //arms re-optimized once the function got hot, used by calls made from then on.
+    //frames already running keep the arms they started with
+    uint32_t calls = 0;
+    bool hot = false;
+    std::vector<Arm> hotMap;
+    int32_t hotTemps = 0;
+
+    std::vector<uint64_t> armHits; //per arm of map, with PassOptions::countArms
+
+    //whether calls are looked up in the result cache (result_cache.hpp), found out on
+    //the first call made with one, and the hash of the name they're keyed on
+    enum ResultCaching : uint8_t
+    {
+        UNCHECKED,
+        CHEAP,
+        EXPENSIVE
+    } resultCaching = UNCHECKED;
+    uint64_t nameHash = 0;
+};
 
+//"import name" at the top level of a file, loading name.opal next to it
+struct Import
+{
+    std::string name;
     int32_t line;
+    int32_t charIdx;
 };
 
 struct AST
 {
 private:
-    std::vector<Expression> expressionBuf;
+    std::vector<Expression, TrackedAllocator<Expression, MEM_EXPRESSIONS>> expressionBuf;
+    std::unordered_map<std::string, size_t> functionIndex;
+
+    //handles of the interned nodes, hashed by structure with linear probing
+    std::vector<ExpressionHandle, TrackedAllocator<ExpressionHandle, MEM_EXPRESSIONS>> internTable;
+    size_t numInterned = 0;
+
+    size_t find_interned(const Expression& exp);
 
 public:
     std::vector<Function> functions;
+    TokenList tokens; //kept for unparsed function bodies
+    std::vector<Import> imports;
+    RelocationList relocations; //of every arm
+    PassOptions passes;
+    uint64_t sourceHash = 0; //stable_hash (loader.hpp) of the sources of load_program
 
     Expression& get_exp(ExpressionHandle i) { return expressionBuf[i]; }
     ExpressionHandle add_exp(Expression e) { expressionBuf.push_back(e); return expressionBuf.size() - 1; }
+    size_t num_exps() const { return expressionBuf.size(); }
+
+    //moves line and charIdx of a node under arm to where it occurred in arm. false if
+    //it occurred where it is
+    bool relocate(const Arm& arm, int32_t& line, int32_t& charIdx) const;
+
+    //returns nullptr if no function has the given name
+    Function* find_function(const std::string& name);
+    //returns false (and adds nothing) if a function with the same name already exists
+    bool add_function(Function func);
+    //moves every expression and function of other into this AST, relocating their handles.
+    //functions already defined in this AST are dropped, so check for redefinitions first
+    void merge(AST& other);
+    //appends a deep copy of func (expressions, names and unparsed tokens) from another AST
+    void copy_function(AST& from, const Function& func);
+    //hash-conses the nodes from begin on, which come after their children, with the
+    //structurally equal ones interned before, relocating the arms of funcs that point at
+    //them. nodes merged away are freed and the buffer shrinks to the ones left, so
+    //nothing but funcs may hold handles from begin on. the relocations of the arms of
+    //funcs are read from armRelocations and rebuilt in this AST's
+    void intern(ExpressionHandle begin, Function* funcs, size_t numFuncs, const RelocationList& armRelocations);
 };
 
 #endif
\ No newline at end of file
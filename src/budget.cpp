@@ -0,0 +1,82 @@
+#include "budget.hpp"
+#include "interpreter.hpp"
+#include <algorithm>
+#if defined(__GLIBC__)
+#include <pthread.h>
+#endif
+
+thread_local EvalBudget evalBudget;
+
+//------------------------------------------------------
+//helper func definitions:
+
+//the lowest address calls on this thread may run at, found on its first budget scope
+static uintptr_t thread_stack_limit()
+{
+    static thread_local uintptr_t limit = 0;
+    if(limit != 0)
+        return limit;
+
+#if defined(__GLIBC__)
+    pthread_attr_t attr;
+    if(pthread_getattr_np(pthread_self(), &attr) == 0)
+    {
+        void* low;
+        size_t size;
+        if(pthread_attr_getstack(&attr, &low, &size) == 0)
+            limit = (uintptr_t)low + std::min(STACK_RESERVE, size / 4);
+        pthread_attr_destroy(&attr);
+    }
+#endif
+
+    if(limit == 0)
+    {
+        const char marker = 0;
+        limit = (uintptr_t)&marker - DEFAULT_STACK_SIZE + STACK_RESERVE;
+    }
+    return limit;
+}
+
+//------------------------------------------------------
+//non-static func definitions:
+
+void refill_budget(int32_t line)
+{
+    const char marker = 0;
+    if((uintptr_t)&marker < evalBudget.stackLimit)
+        throw new RuntimeErrorBudgetExceeded(RuntimeErrorBudgetExceeded::DEPTH, line, 0);
+    if(evalBudget.cancel != nullptr && evalBudget.cancel->load(std::memory_order_relaxed))
+        throw new RuntimeErrorBudgetExceeded(RuntimeErrorBudgetExceeded::CANCELLED, line, 0);
+    if(evalBudget.hasDeadline && std::chrono::steady_clock::now() >= evalBudget.deadline)
+        throw new RuntimeErrorBudgetExceeded(RuntimeErrorBudgetExceeded::DEADLINE, line, 0);
+
+    //the call that ran the countdown out takes the first unit of the refill
+    int64_t refill = evalBudget.hasDeadline || evalBudget.cancel != nullptr ? BUDGET_CHECK_INTERVAL : INT64_MAX;
+    if(evalBudget.fuel >= 0)
+    {
+        if(evalBudget.fuel == 0)
+            throw new RuntimeErrorBudgetExceeded(RuntimeErrorBudgetExceeded::FUEL, line, 0);
+
+        refill = std::min(refill, evalBudget.fuel);
+        evalBudget.fuel -= refill;
+    }
+
+    evalBudget.countdown = refill - 1;
+}
+
+EvalBudgetScope::EvalBudgetScope(const EvalLimits& limits)
+{
+    previous = evalBudget;
+
+    evalBudget.fuel = limits.fuel;
+    evalBudget.hasDeadline = limits.timeout.count() > 0;
+    evalBudget.deadline = std::chrono::steady_clock::now() + limits.timeout;
+    evalBudget.cancel = limits.cancel;
+    evalBudget.stackLimit = thread_stack_limit();
+    evalBudget.countdown = evalBudget.fuel >= 0 || evalBudget.hasDeadline || evalBudget.cancel != nullptr ? 0 : INT64_MAX;
+}
+
+EvalBudgetScope::~EvalBudgetScope()
+{
+    evalBudget = previous;
+}
@@ -0,0 +1,68 @@
+#ifndef OPAL_BUDGET_H
+#define OPAL_BUDGET_H
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+//------------------------------------------------------
+//evaluation budgets:
+//
+//every call is charged one unit of fuel. rather than checking the fuel and the clock
+//on every call, a thread counts down to its next check, which then refills the
+//countdown from the remaining fuel. with a deadline or a cancel flag, those are
+//checked every BUDGET_CHECK_INTERVAL calls.
+//
+//calls nest on the native stack, so however much fuel or time is left, a call that
+//would run too close to the end of the thread's stack fails instead of overflowing it
+
+struct EvalLimits
+{
+    int64_t fuel = -1;                                //calls allowed, -1 for no limit
+    std::chrono::steady_clock::duration timeout = {}; //zero for no deadline
+    const std::atomic<bool>* cancel = nullptr;        //stops the evaluation once set
+};
+
+struct EvalBudget
+{
+    int64_t countdown = INT64_MAX; //calls left before the next check
+    int64_t fuel = -1;             //fuel left after the countdown, -1 for no limit
+    bool hasDeadline = false;
+    std::chrono::steady_clock::time_point deadline;
+    const std::atomic<bool>* cancel = nullptr;
+    uintptr_t stackLimit = 0; //calls made with the stack below it fail
+};
+
+constexpr int64_t BUDGET_CHECK_INTERVAL = 4096;
+
+//native stack kept free below the deepest call, for whatever runs between two calls and
+//for throwing the error, at most a quarter of the stack
+constexpr size_t STACK_RESERVE = 256 * 1024;
+//stack used below the first budget scope of a thread whose stack isn't known
+constexpr size_t DEFAULT_STACK_SIZE = 512 * 1024;
+
+extern thread_local EvalBudget evalBudget;
+
+//called when the countdown runs out or the stack is deep. throws
+//RuntimeErrorBudgetExceeded, blaming the function defined at line, if the budget is
+//used up or the stack is too deep to call it
+void refill_budget(int32_t line);
+
+inline void charge_call(int32_t line)
+{
+    const char marker = 0;
+    if(--evalBudget.countdown < 0 || (uintptr_t)&marker < evalBudget.stackLimit)
+        refill_budget(line);
+}
+
+//limits the evaluations made on this thread for as long as it's alive
+class EvalBudgetScope
+{
+    EvalBudget previous;
+
+public:
+    EvalBudgetScope(const EvalLimits& limits);
+    ~EvalBudgetScope();
+};
+
+#endif
@@ -0,0 +1,481 @@
+#include "closure.hpp"
+#include "interpreter.hpp"
+#include "parser.hpp"
+#include "stats.hpp"
+#include "budget.hpp"
+#include "arrays.hpp"
+#include "result_cache.hpp"
+#include <algorithm>
+
+//------------------------------------------------------
+//operand fetching:
+
+enum OperandKind
+{
+    OPERAND_NODE,
+    OPERAND_SLOT,
+    OPERAND_LITERAL
+};
+
+template<int KIND> struct Operand;
+
+template<> struct Operand<OPERAND_NODE>
+{
+    static Value get(const ClosureNode::Operand& o, Value* frame) { return o.node->eval(o.node, frame); }
+};
+
+template<> struct Operand<OPERAND_SLOT>
+{
+    static Value get(const ClosureNode::Operand& o, Value* frame) { return frame[o.slot]; }
+};
+
+template<> struct Operand<OPERAND_LITERAL>
+{
+    static Value get(const ClosureNode::Operand& o, Value*) { return Value::from_bits(o.literal); }
+};
+
+//------------------------------------------------------
+//operators:
+
+template<Operator OP>
+inline static Value apply(Value l, Value r)
+{
+    switch(OP)
+    {
+    case ADD:       return l + r;
+    case SUB:       return l - r;
+    case MULT:      return l * r;
+    case DIV:       return l / r;
+    case MOD:       return l % r;
+    case EXP:       return l.to(r);
+    case EQUALITY:  return l == r;
+    case LESS:      return l < r;
+    case GREATER:   return l > r;
+    case LESSEQ:    return l <= r;
+    case GREATEREQ: return l >= r;
+    default:        return Value(true);
+    }
+}
+
+//inline ints are only 48 bits, so adding, subtracting and comparing them can't overflow.
+//arrays are only checked for once that fails
+template<Operator OP>
+inline static Value apply_fast(const ClosureNode* node, Value l, Value r)
+{
+    if(l.tag() == Value::TAG_INT && r.tag() == Value::TAG_INT)
+    {
+        int64_t a = l.as_int();
+        int64_t b = r.as_int();
+        switch(OP)
+        {
+        case ADD:       return Value(a + b);
+        case SUB:       return Value(a - b);
+        case EQUALITY:  return Value(a == b);
+        case LESS:      return Value(a < b);
+        case GREATER:   return Value(a > b);
+        case LESSEQ:    return Value(a <= b);
+        case GREATEREQ: return Value(a >= b);
+        default:        break;
+        }
+    }
+
+    if(l.is_array() || r.is_array())
+        return array_operator(OP, l, r, node->line, node->charIdx);
+    return apply<OP>(l, r);
+}
+
+template<Operator OP, int L, int R>
+static Value eval_binary(const ClosureNode* node, Value* frame)
+{
+    OPAL_EVAL_STAT_INC(operators[OP]);
+
+    Value l = Operand<L>::get(node->left, frame);
+    Value r = Operand<R>::get(node->right, frame);
+    return apply_fast<OP>(node, l, r);
+}
+
+template<Operator OP>
+static ClosureFn binary_fn(int l, int r)
+{
+    static const ClosureFn TABLE[3][3] = {
+        {eval_binary<OP, OPERAND_NODE, OPERAND_NODE>,    eval_binary<OP, OPERAND_NODE, OPERAND_SLOT>,    eval_binary<OP, OPERAND_NODE, OPERAND_LITERAL>},
+        {eval_binary<OP, OPERAND_SLOT, OPERAND_NODE>,    eval_binary<OP, OPERAND_SLOT, OPERAND_SLOT>,    eval_binary<OP, OPERAND_SLOT, OPERAND_LITERAL>},
+        {eval_binary<OP, OPERAND_LITERAL, OPERAND_NODE>, eval_binary<OP, OPERAND_LITERAL, OPERAND_SLOT>, eval_binary<OP, OPERAND_LITERAL, OPERAND_LITERAL>}
+    };
+
+    return TABLE[l][r];
+}
+
+//evaluates op on two literals, which are never arrays, without counting it like a
+//running operator would be
+static Value fold_binary(Operator op, Value l, Value r)
+{
+    switch(op)
+    {
+    case ADD:       return apply<ADD>(l, r);
+    case SUB:       return apply<SUB>(l, r);
+    case MULT:      return apply<MULT>(l, r);
+    case DIV:       return apply<DIV>(l, r);
+    case MOD:       return apply<MOD>(l, r);
+    case EXP:       return apply<EXP>(l, r);
+    case EQUALITY:  return apply<EQUALITY>(l, r);
+    case LESS:      return apply<LESS>(l, r);
+    case GREATER:   return apply<GREATER>(l, r);
+    case LESSEQ:    return apply<LESSEQ>(l, r);
+    default:        return apply<GREATEREQ>(l, r);
+    }
+}
+
+static ClosureFn select_binary(Operator op, int l, int r)
+{
+    switch(op)
+    {
+    case ADD:       return binary_fn<ADD>(l, r);
+    case SUB:       return binary_fn<SUB>(l, r);
+    case MULT:      return binary_fn<MULT>(l, r);
+    case DIV:       return binary_fn<DIV>(l, r);
+    case MOD:       return binary_fn<MOD>(l, r);
+    case EXP:       return binary_fn<EXP>(l, r);
+    case EQUALITY:  return binary_fn<EQUALITY>(l, r);
+    case LESS:      return binary_fn<LESS>(l, r);
+    case GREATER:   return binary_fn<GREATER>(l, r);
+    case LESSEQ:    return binary_fn<LESSEQ>(l, r);
+    case GREATEREQ: return binary_fn<GREATEREQ>(l, r);
+    default:        return nullptr;
+    }
+}
+
+//------------------------------------------------------
+//leaves and calls:
+
+static Value eval_slot(const ClosureNode* node, Value* frame)
+{
+    return frame[node->left.slot];
+}
+
+static Value eval_literal(const ClosureNode* node, Value*)
+{
+    return Value::from_bits(node->left.literal);
+}
+
+static Value eval_unknown_variable(const ClosureNode* node, Value*)
+{
+    throw new RuntimeErrorInvalidVariable(node->line, node->charIdx);
+}
+
+static Value eval_unknown_function(const ClosureNode* node, Value*)
+{
+    throw new RuntimeErrorFuncNotFound(node->name, node->line, node->charIdx);
+}
+
+static Value eval_invalid_operator(const ClosureNode* node, Value*)
+{
+    throw new RuntimeErrorInvalidOperator(node->line, node->charIdx);
+}
+
+//cse temps live in the frame after the params, and are only computed once first read
+static Value eval_temp(const ClosureNode* node, Value* frame)
+{
+    Value& slot = frame[node->left.slot];
+    if(slot.bits == Value::EMPTY_BITS)
+        slot = node->right.node->eval(node->right.node, frame);
+    return slot;
+}
+
+static Value eval_call(const ClosureNode* node, Value* frame)
+{
+    Value stackArgs[MAX_STACK_ARGS];
+    ValueFrames heapArgs;
+
+    Value* args = stackArgs;
+    if(node->numArgs > MAX_STACK_ARGS)
+    {
+        heapArgs.resize(node->numArgs);
+        args = heapArgs.data();
+    }
+
+    for(int32_t i = 0; i < node->numArgs; i++)
+        args[i] = node->args[i]->eval(node->args[i], frame);
+
+    return call_closure(node->target, args, node->numArgs);
+}
+
+static Value eval_builtin(const ClosureNode* node, Value* frame)
+{
+    Value stackArgs[MAX_STACK_ARGS];
+    ValueFrames heapArgs;
+
+    Value* args = stackArgs;
+    if(node->numArgs > MAX_STACK_ARGS)
+    {
+        heapArgs.resize(node->numArgs);
+        args = heapArgs.data();
+    }
+
+    for(int32_t i = 0; i < node->numArgs; i++)
+        args[i] = node->args[i]->eval(node->args[i], frame);
+
+    return call_builtin(node->builtin, args, node->numArgs, node->line, node->charIdx);
+}
+
+//------------------------------------------------------
+//compilation:
+
+static ClosureNode* new_node(ClosureProgram* program, ClosureFn eval, const Expression& exp)
+{
+    program->nodes.push_back(ClosureNode());
+    ClosureNode* node = &program->nodes.back();
+    node->eval = eval;
+    node->target = nullptr;
+    node->builtin = nullptr;
+    node->args = nullptr;
+    node->numArgs = 0;
+    node->name = nullptr;
+    node->line = exp.line;
+    node->charIdx = exp.charIdx;
+    return node;
+}
+
+static int operand_kind(const ClosureNode* node)
+{
+    if(node->eval == eval_slot)
+        return OPERAND_SLOT;
+    if(node->eval == eval_literal)
+        return OPERAND_LITERAL;
+    return OPERAND_NODE;
+}
+
+static ClosureNode::Operand operand_of(const ClosureNode* node)
+{
+    ClosureNode::Operand operand;
+    switch(operand_kind(node))
+    {
+    case OPERAND_SLOT:
+        operand.slot = node->left.slot;
+        break;
+    case OPERAND_LITERAL:
+        operand.literal = node->left.literal;
+        break;
+    default:
+        operand.node = node;
+        break;
+    }
+    return operand;
+}
+
+//nodes shared between arms are compiled once per arm they're under, so each is placed
+//where it occurred in arm
+static const ClosureNode* compile_expression(ClosureProgram* program, Function* func, const Arm& arm, ExpressionHandle handle)
+{
+    //copied, since compiling a call may parse a lazy function and grow the expression buffer
+    Expression exp = program->ast->get_exp(handle);
+    program->ast->relocate(arm, exp.line, exp.charIdx);
+
+    switch(exp.type)
+    {
+    case Expression::OPERATOR:
+    {
+        if(exp.op.op == OTHERWISE)
+        {
+            ClosureNode* node = new_node(program, eval_literal, exp);
+            node->left.literal = Value(true).bits;
+            return node;
+        }
+
+        const ClosureNode* left = compile_expression(program, func, arm, exp.op.left);
+        const ClosureNode* right = compile_expression(program, func, arm, exp.op.right);
+
+        ClosureFn eval = select_binary(exp.op.op, operand_kind(left), operand_kind(right));
+        if(eval == nullptr)
+            return new_node(program, eval_invalid_operator, exp);
+
+        ClosureNode* node = new_node(program, eval, exp);
+        node->left = operand_of(left);
+        node->right = operand_of(right);
+
+        //fold operations on literals, unless the result would need a box or they divide
+        //by zero, which is left to fail at runtime
+        bool divByZero = (exp.op.op == DIV || exp.op.op == MOD) && operand_kind(right) == OPERAND_LITERAL && Value::from_bits(right->left.literal).get_scalar() == 0;
+        if(operand_kind(left) == OPERAND_LITERAL && operand_kind(right) == OPERAND_LITERAL && !divByZero)
+        {
+            const BoxMark boxMark = mark_boxes();
+            Value folded = fold_binary(exp.op.op, Value::from_bits(left->left.literal), Value::from_bits(right->left.literal));
+            if(!folded.is_boxed())
+            {
+                node->eval = eval_literal;
+                node->left.literal = folded.bits;
+            }
+            release_boxes(boxMark, Value(false));
+        }
+
+        return node;
+    }
+    case Expression::FUNCTION:
+    {
+        //builtins are only called when no function of the program shadows them
+        CompiledFunction* target = find_compiled(program, exp.func.name);
+        const Builtin* builtin = target ? nullptr : find_builtin(exp.func.name);
+        ClosureNode* node = new_node(program, target ? eval_call : builtin ? eval_builtin : eval_unknown_function, exp);
+        node->target = target;
+        node->builtin = builtin;
+        node->name = exp.func.name;
+        node->numArgs = exp.func.numParams;
+
+        program->argArrays.emplace_back(exp.func.numParams);
+        node->args = program->argArrays.back().data();
+        for(int32_t i = 0; i < exp.func.numParams; i++)
+            node->args[i] = compile_expression(program, func, arm, program->ast->get_exp(handle).func.params[i]);
+
+        return node;
+    }
+    case Expression::VARIABLE:
+    {
+        if(exp.var.slot < 0)
+            return new_node(program, eval_unknown_variable, exp);
+
+        ClosureNode* node = new_node(program, eval_slot, exp);
+        node->left.slot = exp.var.slot;
+        return node;
+    }
+    case Expression::TEMP:
+    {
+        const ClosureNode* def = compile_expression(program, func, arm, exp.temp.exp);
+        if(operand_kind(def) != OPERAND_NODE)
+            return def;
+
+        ClosureNode* node = new_node(program, eval_temp, exp);
+        node->left.slot = exp.temp.slot;
+        node->right.node = def;
+        return node;
+    }
+    case Expression::INT_LITERAL:
+    {
+        ClosureNode* node = new_node(program, eval_literal, exp);
+        node->left.literal = Value((int64_t)exp.intLit.val).bits;
+        return node;
+    }
+    case Expression::FLOAT_LITERAL:
+    {
+        ClosureNode* node = new_node(program, eval_literal, exp);
+        node->left.literal = Value(exp.floatLit.val).bits;
+        return node;
+    }
+    default:
+        throw new RuntimeErrorInvalidExpression(exp.line, exp.charIdx);
+    }
+}
+
+static void compile_function(CompiledFunction* compiled)
+{
+    ClosureProgram* program = compiled->program;
+    Function* func = compiled->source;
+    if(!func->parsed)
+        parse_lazy_function(program->ast, func);
+
+    for(auto& arm : func->map)
+    {
+        Expression guard = program->ast->get_exp(arm.second);
+
+        ClosureArm closureArm;
+        closureArm.line = guard.line;
+        closureArm.charIdx = guard.charIdx;
+        closureArm.guard = nullptr;
+        if(guard.type != Expression::OPERATOR || guard.op.op != OTHERWISE)
+            closureArm.guard = compile_expression(program, func, arm, arm.second);
+        closureArm.body = compile_expression(program, func, arm, arm.first);
+
+        compiled->arms.push_back(closureArm);
+    }
+
+    compiled->compiled = true;
+}
+
+//------------------------------------------------------
+//non-static func definitions:
+
+ClosureProgram* compile_closures(AST* ast, bool eager)
+{
+    ClosureProgram* program = new ClosureProgram;
+    program->ast = ast;
+
+    program->functions.reserve(ast->functions.size());
+    for(Function& func : ast->functions)
+        program->functions.push_back({program, &func, {}, false});
+
+    if(eager)
+        for(CompiledFunction& func : program->functions)
+            if(!func.compiled)
+                compile_function(&func);
+
+    return program;
+}
+
+void free_closures(ClosureProgram* program)
+{
+    delete program;
+}
+
+CompiledFunction* find_compiled(ClosureProgram* program, const std::string& name)
+{
+    Function* func = program->ast->find_function(name);
+    if(func == nullptr)
+        return nullptr;
+
+    return &program->functions[func - program->ast->functions.data()];
+}
+
+//evaluates a call to func with args
+static Value run_arms(CompiledFunction* func, Value* args, int32_t numArgs)
+{
+    if(!func->compiled)
+        compile_function(func);
+
+    if(numArgs != (int32_t)func->source->params.size())
+        throw new RuntimeErrorIncorrectNumArgs(func->source->name, numArgs, func->source->line, 0);
+
+    //functions with cse temps need a frame with room for them after the args
+    Value* frame = args;
+    Value stackFrame[MAX_STACK_ARGS];
+    ValueFrames heapFrame;
+    if(func->source->numTemps > 0)
+    {
+        int32_t frameSize = numArgs + func->source->numTemps;
+        frame = stackFrame;
+        if(frameSize > MAX_STACK_ARGS)
+        {
+            heapFrame.resize(frameSize);
+            frame = heapFrame.data();
+        }
+
+        std::copy(args, args + numArgs, frame);
+        std::fill(frame + numArgs, frame + frameSize, Value::from_bits(Value::EMPTY_BITS));
+    }
+
+    const BoxMark boxMark = mark_boxes();
+    for(const ClosureArm& arm : func->arms)
+    {
+        if(arm.guard != nullptr)
+        {
+            Value condResult = arm.guard->eval(arm.guard, frame);
+            if(!condResult.is_bool())
+                throw new RuntimeErrorInvalidCondition(arm.line, arm.charIdx);
+            if(!condResult.is_true())
+                continue;
+        }
+
+        return release_boxes(boxMark, arm.body->eval(arm.body, frame));
+    }
+
+    return release_boxes(boxMark, Value((int64_t)0));
+}
+
+Value call_closure(CompiledFunction* func, Value* args, int32_t numArgs)
+{
+    OPAL_EVAL_STAT_INC(calls);
+    OPAL_EVAL_STAT_DEPTH();
+    charge_call(func->source->line);
+
+    if(resultCalls.cache == nullptr)
+        return run_arms(func, args, numArgs);
+    return cached_call(func->source, args, numArgs, [&] { return run_arms(func, args, numArgs); });
+}
@@ -0,0 +1,84 @@
+#ifndef OPAL_CLOSURE_H
+#define OPAL_CLOSURE_H
+
+#include "ast.hpp"
+#include "value.hpp"
+#include <deque>
+#include <memory>
+#include <vector>
+
+//------------------------------------------------------
+//closure compiled tier:
+//
+//every expression is converted once into a node holding a pointer to a function
+//specialized for its operator and the shape of its operands, e.g. "slot + literal".
+//evaluating a node is then a single indirect call, without going back to the AST or
+//switching on its type and operator.
+
+struct ClosureNode;
+struct CompiledFunction;
+struct ClosureProgram;
+struct Builtin;
+
+//frame holds the arguments of the running call, indexed by parameter, followed by its cse temps
+typedef Value (*ClosureFn)(const ClosureNode* node, Value* frame);
+
+struct ClosureNode
+{
+    ClosureFn eval;
+
+    //operands are read straight from the frame or the node when possible
+    union Operand
+    {
+        const ClosureNode* node;
+        int32_t slot;
+        uint64_t literal; //Value bits
+    } left, right;
+
+    //calls:
+    CompiledFunction* target;
+    const Builtin* builtin; //when no function of the program is called that
+    const ClosureNode** args;
+    int32_t numArgs;
+
+    const char* name; //called function or variable, for errors
+    int32_t line;
+    int32_t charIdx;
+};
+
+struct ClosureArm
+{
+    const ClosureNode* body;
+    const ClosureNode* guard; //nullptr for otherwise
+    int32_t line;
+    int32_t charIdx;
+};
+
+struct CompiledFunction
+{
+    ClosureProgram* program;
+    Function* source;
+    std::vector<ClosureArm> arms;
+    bool compiled;
+};
+
+struct ClosureProgram
+{
+    AST* ast;
+    std::deque<ClosureNode> nodes;
+    std::vector<std::vector<const ClosureNode*, TrackedAllocator<const ClosureNode*, MEM_CALL_PARAMS>>> argArrays;
+    std::vector<CompiledFunction> functions; //same order as ast->functions
+};
+
+//most functions take a few arguments, whose frames then live on the native stack
+constexpr int32_t MAX_STACK_ARGS = 8;
+
+//functions are only compiled once first called, so this is cheap. eagerly compiled
+//programs are never modified afterwards and can be called from several threads
+ClosureProgram* compile_closures(AST* ast, bool eager = false);
+void free_closures(ClosureProgram* program);
+
+Value call_closure(CompiledFunction* func, Value* args, int32_t numArgs);
+CompiledFunction* find_compiled(ClosureProgram* program, const std::string& name);
+
+#endif
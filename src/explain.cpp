@@ -0,0 +1,782 @@
+#include "explain.hpp"
+#include "arrays.hpp"
+#include "output.hpp"
+#include "value.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+//------------------------------------------------------
+//helper func definitions:
+
+//types a value can take, as a set of bits. 0 for an expression that never returns
+enum TypeBits : uint8_t
+{
+    TYPE_INT = 1,
+    TYPE_FLOAT = 2,
+    TYPE_BOOL = 4,
+    TYPE_ARRAY = 8,
+
+    TYPE_ANY_ARG = TYPE_INT | TYPE_FLOAT | TYPE_ARRAY //what main's args can be
+};
+
+//costs saturate instead of wrapping around on expressions shared many times over
+constexpr uint64_t MAX_COST = 1ull << 48;
+
+//deeper subexpressions are only printed as "..."
+constexpr int32_t MAX_PRINT_DEPTH = 24;
+
+struct FunctionPlan
+{
+    //every node under the arms, children first. nodes can be shared with other
+    //functions, so what's known about them is kept by position in here
+    std::vector<ExpressionHandle> nodes;
+    std::vector<uint32_t> children;   //positions of the children of every node, in order
+    std::vector<uint32_t> firstChild; //per node, where its children start in children
+    std::vector<uint32_t> bodies;     //positions of the arm bodies
+
+    std::vector<int32_t> callees;     //functions called, each once
+    std::vector<int32_t> callers;
+    int32_t component = -1;           //strongly connected component of the call graph
+    bool recursive = false;
+
+    std::vector<uint8_t> params;
+    uint8_t result = 0;
+};
+
+static uint64_t add_cost(uint64_t a, uint64_t b)
+{
+    return std::min(a + b, MAX_COST);
+}
+
+static std::vector<ExpressionHandle> arm_roots(const Function* func)
+{
+    std::vector<ExpressionHandle> roots;
+    for(const auto& arm : func->map)
+    {
+        roots.push_back(arm.second);
+        roots.push_back(arm.first);
+    }
+    return roots;
+}
+
+//every node under roots once, children before their parents
+static std::vector<ExpressionHandle> post_order_nodes(AST* ast, const std::vector<ExpressionHandle>& roots)
+{
+    std::vector<ExpressionHandle> nodes;
+    std::unordered_set<ExpressionHandle> visited;
+    std::vector<std::pair<ExpressionHandle, bool>> stack;
+    for(auto it = roots.rbegin(); it != roots.rend(); it++)
+        stack.push_back({*it, false});
+
+    while(!stack.empty())
+    {
+        auto [handle, expanded] = stack.back();
+        if(visited.count(handle))
+        {
+            stack.pop_back();
+            continue;
+        }
+
+        if(!expanded)
+        {
+            stack.back().second = true;
+            const size_t first = stack.size();
+            Expression exp = ast->get_exp(handle);
+            for_each_child(exp, [&](ExpressionHandle& child) { stack.push_back({child, false}); });
+            std::reverse(stack.begin() + first, stack.end());
+            continue;
+        }
+
+        stack.pop_back();
+        visited.insert(handle);
+        nodes.push_back(handle);
+    }
+    return nodes;
+}
+
+//index of the function exp names, whatever number of args it's given. -1 for builtins
+//and missing functions. the call graph is built from these, so a self-call with the
+//wrong arg count still makes its function recursive
+static int32_t named_function(AST* ast, const Expression& exp)
+{
+    Function* target = ast->find_function(exp.func.name);
+    return target != nullptr ? (int32_t)(target - ast->functions.data()) : -1;
+}
+
+//index of the function exp calls, -1 for builtins, missing functions and calls with
+//the wrong number of args, which only ever fail
+static int32_t callee_of(AST* ast, const Expression& exp)
+{
+    int32_t callee = named_function(ast, exp);
+    if(callee < 0 || exp.func.numParams != (int32_t)ast->functions[callee].params.size())
+        return -1;
+    return callee;
+}
+
+//the expression a body evaluates to, looking through the temps holding it
+static const Expression& unwrap_temps(AST* ast, ExpressionHandle handle)
+{
+    while(ast->get_exp(handle).type == Expression::TEMP)
+        handle = ast->get_exp(handle).temp.exp;
+    return ast->get_exp(handle);
+}
+
+//the call graph's strongly connected components, numbered in the order tarjan's
+//algorithm completes them, without recursing per call
+static void find_components(std::vector<FunctionPlan>& plans)
+{
+    const int32_t n = (int32_t)plans.size();
+    std::vector<int32_t> index(n, -1), low(n, 0);
+    std::vector<bool> onStack(n, false);
+    std::vector<int32_t> stack;
+    std::vector<std::pair<int32_t, size_t>> work; //function, next callee to visit
+    int32_t nextIndex = 0;
+    int32_t numComponents = 0;
+
+    for(int32_t root = 0; root < n; root++)
+    {
+        if(index[root] >= 0)
+            continue;
+
+        work.push_back({root, 0});
+        while(!work.empty())
+        {
+            auto& [f, next] = work.back();
+            if(next == 0 && index[f] < 0)
+            {
+                index[f] = low[f] = nextIndex++;
+                stack.push_back(f);
+                onStack[f] = true;
+            }
+
+            if(next < plans[f].callees.size())
+            {
+                int32_t callee = plans[f].callees[next++];
+                if(index[callee] < 0)
+                    work.push_back({callee, 0});
+                else if(onStack[callee])
+                    low[f] = std::min(low[f], index[callee]);
+                continue;
+            }
+
+            if(low[f] == index[f])
+            {
+                int32_t member;
+                do
+                {
+                    member = stack.back();
+                    stack.pop_back();
+                    onStack[member] = false;
+                    plans[member].component = numComponents;
+                } while(member != f);
+                numComponents++;
+            }
+
+            const int32_t done = f;
+            work.pop_back();
+            if(!work.empty())
+                low[work.back().first] = std::min(low[work.back().first], low[done]);
+        }
+    }
+
+    std::vector<int32_t> sizes(numComponents, 0);
+    for(const FunctionPlan& plan : plans)
+        sizes[plan.component]++;
+
+    for(int32_t f = 0; f < n; f++)
+    {
+        const auto& callees = plans[f].callees;
+        plans[f].recursive = sizes[plans[f].component] > 1 || std::find(callees.begin(), callees.end(), f) != callees.end();
+    }
+}
+
+//------------------------------------------------------
+//type inference:
+
+static uint8_t operator_type(Operator op, uint8_t l, uint8_t r)
+{
+    if(op == OTHERWISE)
+        return TYPE_BOOL;
+    if(l == 0 || r == 0)
+        return 0;
+
+    //scalars are compared and combined like Value's operators do, bools as ints
+    const uint8_t ls = l & ~TYPE_ARRAY;
+    const uint8_t rs = r & ~TYPE_ARRAY;
+    if(op >= EQUALITY && op <= LESSEQ)
+        return ls && rs ? TYPE_BOOL : 0;
+
+    uint8_t result = 0;
+    if(ls && rs && ((ls | rs) & TYPE_FLOAT))
+        result |= TYPE_FLOAT;
+    if((ls & (TYPE_INT | TYPE_BOOL)) && (rs & (TYPE_INT | TYPE_BOOL)))
+        result |= TYPE_INT;
+    if((op == ADD || op == SUB || op == MULT || op == DIV) && ((l | r) & TYPE_ARRAY))
+        result |= TYPE_ARRAY;
+    return result;
+}
+
+static uint8_t builtin_type(const Builtin* builtin)
+{
+    switch(builtin->result)
+    {
+    case Value::INT:   return TYPE_INT;
+    case Value::FLOAT: return TYPE_FLOAT;
+    case Value::BOOL:  return TYPE_BOOL;
+    default:           return TYPE_ARRAY;
+    }
+}
+
+//types every node of func can take given the current ones of its params and of the
+//results of its callees, joining the types of its args into the params of its callees.
+//callees whose params changed are added to the worklist. true if func's result changed
+static bool infer_function(AST* ast, int32_t f, std::vector<FunctionPlan>& plans, std::vector<int32_t>& worklist, std::vector<bool>& listed)
+{
+    FunctionPlan& plan = plans[f];
+    std::vector<uint8_t> types(plan.nodes.size());
+    for(size_t i = 0; i < plan.nodes.size(); i++)
+    {
+        const Expression& exp = ast->get_exp(plan.nodes[i]);
+        const uint32_t* children = plan.children.data() + plan.firstChild[i];
+        uint8_t type = 0;
+        switch(exp.type)
+        {
+        case Expression::OPERATOR:
+            type = exp.op.op == OTHERWISE ? (uint8_t)TYPE_BOOL : (uint8_t)operator_type(exp.op.op, types[children[0]], types[children[1]]);
+            break;
+        case Expression::FUNCTION:
+        {
+            int32_t callee = callee_of(ast, exp);
+            if(callee >= 0)
+            {
+                FunctionPlan& target = plans[callee];
+                bool changed = false;
+                for(int32_t p = 0; p < exp.func.numParams; p++)
+                {
+                    uint8_t joined = target.params[p] | types[children[p]];
+                    changed |= joined != target.params[p];
+                    target.params[p] = joined;
+                }
+                if(changed && !listed[callee])
+                {
+                    worklist.push_back(callee);
+                    listed[callee] = true;
+                }
+                type = target.result;
+            }
+            else if(const Builtin* builtin = find_builtin(exp.func.name))
+                type = builtin_type(builtin);
+            break;
+        }
+        case Expression::VARIABLE:
+            type = exp.var.slot >= 0 && exp.var.slot < (int32_t)plan.params.size() ? plan.params[exp.var.slot] : 0;
+            break;
+        case Expression::TEMP:
+            type = types[children[0]];
+            break;
+        case Expression::INT_LITERAL:
+            type = TYPE_INT;
+            break;
+        case Expression::FLOAT_LITERAL:
+            type = TYPE_FLOAT;
+            break;
+        }
+        types[i] = type;
+    }
+
+    uint8_t result = plan.result;
+    for(uint32_t body : plan.bodies)
+        result |= types[body];
+
+    const bool changed = result != plan.result;
+    plan.result = result;
+    return changed;
+}
+
+//types only ever gain bits, so every function is listed again at most a few times
+static void infer_types(AST* ast, std::vector<FunctionPlan>& plans)
+{
+    std::vector<int32_t> worklist;
+    std::vector<bool> listed(plans.size(), false);
+    for(size_t f = 0; f < plans.size(); f++)
+    {
+        const bool entry = plans[f].callers.empty() || ast->functions[f].name == "main";
+        plans[f].params.assign(ast->functions[f].params.size(), entry ? TYPE_ANY_ARG : 0);
+        if(ast->functions[f].parsed)
+        {
+            worklist.push_back((int32_t)f);
+            listed[f] = true;
+        }
+    }
+
+    //callers are listed last first, so a chain of calls resolves from its end
+    std::reverse(worklist.begin(), worklist.end());
+    while(!worklist.empty())
+    {
+        int32_t f = worklist.back();
+        worklist.pop_back();
+        listed[f] = false;
+
+        if(!infer_function(ast, f, plans, worklist, listed))
+            continue;
+
+        for(int32_t caller : plans[f].callers)
+        {
+            if(!listed[caller])
+            {
+                worklist.push_back(caller);
+                listed[caller] = true;
+            }
+        }
+    }
+}
+
+static std::string type_text(uint8_t type)
+{
+    static const char* const NAMES[] = {"int", "float", "bool", "array"};
+    if(type == 0)
+        return "none";
+
+    std::string text;
+    for(int32_t bit = 0; bit < 4; bit++)
+    {
+        if(!(type & (1 << bit)))
+            continue;
+        if(!text.empty())
+            text += "|";
+        text += NAMES[bit];
+    }
+    return text;
+}
+
+//------------------------------------------------------
+//printing expressions:
+
+static void print_expression(AST* ast, const Function* func, ExpressionHandle handle, std::string& out, int32_t depth);
+
+//operands that would otherwise bind differently are parenthesized
+static void print_operand(AST* ast, const Function* func, ExpressionHandle handle, bool parens, std::string& out, int32_t depth)
+{
+    if(parens)
+        out += "(";
+    print_expression(ast, func, handle, out, depth);
+    if(parens)
+        out += ")";
+}
+
+static bool is_operator(const Expression& exp)
+{
+    return exp.type == Expression::OPERATOR && exp.op.op != OTHERWISE;
+}
+
+static void print_expression(AST* ast, const Function* func, ExpressionHandle handle, std::string& out, int32_t depth)
+{
+    if(depth > MAX_PRINT_DEPTH)
+    {
+        out += "...";
+        return;
+    }
+
+    const Expression& exp = ast->get_exp(handle);
+    switch(exp.type)
+    {
+    case Expression::OPERATOR:
+    {
+        if(exp.op.op == OTHERWISE)
+        {
+            out += "otherwise";
+            break;
+        }
+
+        const BindingPower power = binding_power(exp.op.op);
+        const Expression& left = ast->get_exp(exp.op.left);
+        const Expression& right = ast->get_exp(exp.op.right);
+        print_operand(ast, func, exp.op.left, is_operator(left) && power.left >= binding_power(left.op.op).right, out, depth + 1);
+        out += " ";
+        out += OPERATOR_SPELLINGS[exp.op.op];
+        out += " ";
+        print_operand(ast, func, exp.op.right, is_operator(right) && binding_power(right.op.op).left < power.right, out, depth + 1);
+        break;
+    }
+    case Expression::FUNCTION:
+    {
+        const bool literal = strcmp(exp.func.name, ARRAY_LITERAL_NAME) == 0;
+        if(strcmp(exp.func.name, ARRAY_INDEX_NAME) == 0 && exp.func.numParams == 2)
+        {
+            print_operand(ast, func, exp.func.params[0], is_operator(ast->get_exp(exp.func.params[0])), out, depth + 1);
+            out += "[";
+            print_expression(ast, func, exp.func.params[1], out, depth + 1);
+            out += "]";
+            break;
+        }
+
+        out += literal ? "[" : std::string(exp.func.name) + "(";
+        for(int32_t i = 0; i < exp.func.numParams; i++)
+        {
+            if(i > 0)
+                out += ", ";
+            print_expression(ast, func, exp.func.params[i], out, depth + 1);
+        }
+        out += literal ? "]" : ")";
+        break;
+    }
+    case Expression::VARIABLE:
+        out += exp.var.name;
+        break;
+    case Expression::TEMP:
+        out += "t" + std::to_string(exp.temp.slot - (int32_t)func->params.size());
+        break;
+    case Expression::INT_LITERAL:
+        out += std::to_string(exp.intLit.val);
+        break;
+    case Expression::FLOAT_LITERAL:
+    {
+        char text[MAX_VALUE_CHARS];
+        out.append(text, format_value(Value(exp.floatLit.val), text));
+        break;
+    }
+    }
+}
+
+//------------------------------------------------------
+//per function plans:
+
+//nodes evaluated per call and recursive calls made, by node. a temp only counts as
+//one node here, its expression being evaluated once per call
+struct NodeCost
+{
+    uint64_t nodes;
+    uint64_t recursiveCalls;
+};
+
+static std::unordered_map<ExpressionHandle, NodeCost> node_costs(AST* ast, const FunctionPlan& plan, const std::vector<FunctionPlan>& plans)
+{
+    std::unordered_map<ExpressionHandle, NodeCost> costs;
+    for(ExpressionHandle handle : plan.nodes)
+    {
+        Expression exp = ast->get_exp(handle);
+        NodeCost cost = {1, 0};
+        if(exp.type == Expression::TEMP)
+        {
+            costs[handle] = cost;
+            continue;
+        }
+
+        for_each_child(exp, [&](ExpressionHandle& child)
+        {
+            cost.nodes = add_cost(cost.nodes, costs[child].nodes);
+            cost.recursiveCalls = add_cost(cost.recursiveCalls, costs[child].recursiveCalls);
+        });
+
+        if(exp.type == Expression::FUNCTION)
+        {
+            int32_t callee = named_function(ast, exp);
+            if(callee >= 0 && plans[callee].component == plan.component && plan.recursive)
+                cost.recursiveCalls++;
+        }
+        costs[handle] = cost;
+    }
+    return costs;
+}
+
+//cost of evaluating the roots once, with each temp under them evaluated once
+static NodeCost roots_cost(AST* ast, const std::vector<ExpressionHandle>& roots, std::unordered_map<ExpressionHandle, NodeCost>& costs)
+{
+    NodeCost total = {0, 0};
+    for(ExpressionHandle root : roots)
+    {
+        total.nodes = add_cost(total.nodes, costs[root].nodes);
+        total.recursiveCalls = add_cost(total.recursiveCalls, costs[root].recursiveCalls);
+    }
+
+    std::unordered_set<int32_t> temps;
+    for(ExpressionHandle handle : post_order_nodes(ast, roots))
+    {
+        const Expression& exp = ast->get_exp(handle);
+        if(exp.type == Expression::TEMP && temps.insert(exp.temp.slot).second)
+        {
+            total.nodes = add_cost(total.nodes, costs[exp.temp.exp].nodes);
+            total.recursiveCalls = add_cost(total.recursiveCalls, costs[exp.temp.exp].recursiveCalls);
+        }
+    }
+    return total;
+}
+
+//"n" if every guard compares that param with a literal, "" otherwise
+static std::string switched_param(AST* ast, const Function* func)
+{
+    int32_t slot = -1;
+    for(const auto& arm : func->map)
+    {
+        const Expression& guard = ast->get_exp(arm.second);
+        if(guard.type != Expression::OPERATOR || guard.op.op == OTHERWISE)
+            continue;
+        if(guard.op.op < EQUALITY || guard.op.op > LESSEQ)
+            return "";
+
+        const Expression& left = ast->get_exp(guard.op.left);
+        const Expression& right = ast->get_exp(guard.op.right);
+        const Expression& var = left.type == Expression::VARIABLE ? left : right;
+        const Expression& literal = left.type == Expression::VARIABLE ? right : left;
+        if(var.type != Expression::VARIABLE || var.var.slot < 0 || (literal.type != Expression::INT_LITERAL && literal.type != Expression::FLOAT_LITERAL))
+            return "";
+        if(slot >= 0 && var.var.slot != slot)
+            return "";
+        slot = var.var.slot;
+    }
+    return slot >= 0 ? func->params[slot] : "";
+}
+
+static bool is_otherwise(AST* ast, ExpressionHandle guard)
+{
+    const Expression& exp = ast->get_exp(guard);
+    return exp.type == Expression::OPERATOR && exp.op.op == OTHERWISE;
+}
+
+static void explain_function(AST* ast, int32_t f, const std::vector<FunctionPlan>& plans, std::string& out, std::vector<std::string>& hotspots)
+{
+    const Function* func = &ast->functions[f];
+    const FunctionPlan& plan = plans[f];
+
+    out += "fn " + func->name;
+    if(!func->params.empty())
+        out += " of";
+    for(const std::string& param : func->params)
+        out += " " + param;
+    out += "  (line " + std::to_string(func->line) + ")\n";
+
+    if(!func->parsed)
+    {
+        out += "    not parsed yet\n\n";
+        return;
+    }
+
+    //arms and their dispatch:
+    //----------------
+    const size_t numArms = func->map.size();
+    const bool endsInOtherwise = numArms > 0 && is_otherwise(ast, func->map.back().second);
+    if(numArms == 1 && endsInOtherwise)
+        out += "    dispatch: one arm, no guard\n";
+    else
+    {
+        out += "    dispatch: " + std::to_string(numArms) + " arms, guards tested in order";
+        std::string param = switched_param(ast, func);
+        if(!param.empty())
+            out += ", comparing " + param + " with constants";
+        out += endsInOtherwise ? ", then otherwise\n" : ", 0 when none holds\n";
+    }
+
+    for(const auto& arm : func->map)
+    {
+        out += "        ";
+        print_expression(ast, func, arm.first, out, 0);
+        out += " : ";
+        print_expression(ast, func, arm.second, out, 0);
+        out += "\n";
+    }
+
+    std::vector<const Expression*> temps;
+    for(ExpressionHandle handle : plan.nodes)
+    {
+        const Expression& exp = ast->get_exp(handle);
+        if(exp.type == Expression::TEMP && std::none_of(temps.begin(), temps.end(), [&](const Expression* t) { return t->temp.slot == exp.temp.slot; }))
+            temps.push_back(&exp);
+    }
+    std::sort(temps.begin(), temps.end(), [](const Expression* a, const Expression* b) { return a->temp.slot < b->temp.slot; });
+    for(const Expression* temp : temps)
+    {
+        out += "    temp t" + std::to_string(temp->temp.slot - (int32_t)func->params.size()) + " = ";
+        print_expression(ast, func, temp->temp.exp, out, 0);
+        out += "\n";
+    }
+
+    //call targets, tail calls being those a body evaluates to:
+    //----------------
+    struct CallSites
+    {
+        std::string name;
+        int32_t sites = 0;
+        int32_t tail = 0;
+        int32_t wrongArgs = 0; //passing a number of args the target doesn't take
+    };
+    std::vector<CallSites> sites;
+    auto site = [&](const std::string& name) -> CallSites&
+    {
+        for(auto& s : sites)
+            if(s.name == name)
+                return s;
+        sites.push_back({name});
+        return sites.back();
+    };
+
+    //array literals and indexing are only calls to the parser
+    for(ExpressionHandle handle : plan.nodes)
+    {
+        const Expression& exp = ast->get_exp(handle);
+        if(exp.type != Expression::FUNCTION || strcmp(exp.func.name, ARRAY_LITERAL_NAME) == 0 || strcmp(exp.func.name, ARRAY_INDEX_NAME) == 0)
+            continue;
+
+        CallSites& s = site(exp.func.name);
+        s.sites++;
+        const Function* target = ast->find_function(exp.func.name);
+        if(target != nullptr && exp.func.numParams != (int32_t)target->params.size())
+            s.wrongArgs++;
+    }
+    for(const auto& arm : func->map)
+    {
+        const Expression& body = unwrap_temps(ast, arm.first);
+        if(body.type == Expression::FUNCTION && callee_of(ast, body) >= 0)
+            site(body.func.name).tail++;
+    }
+
+    if(!sites.empty())
+    {
+        out += "    calls:";
+        for(size_t i = 0; i < sites.size(); i++)
+        {
+            const CallSites& s = sites[i];
+            const Function* target = ast->find_function(s.name);
+            out += (i > 0 ? ", " : " ") + s.name;
+
+            std::vector<std::string> notes;
+            if(target == nullptr)
+                notes.push_back(find_builtin(s.name.c_str()) != nullptr ? "builtin" : "not found");
+            else if(target != func)
+                notes.push_back("line " + std::to_string(target->line));
+            if(s.sites > 1)
+                notes.push_back(std::to_string(s.sites) + " sites");
+            if(s.wrongArgs > 0)
+            {
+                const std::string takes = "takes " + std::to_string(target->params.size()) + " args";
+                notes.push_back(s.wrongArgs == s.sites ? "wrong arg count, " + takes : std::to_string(s.wrongArgs) + " with wrong arg count, " + takes);
+            }
+            if(s.tail > 0)
+                notes.push_back(s.tail == s.sites ? "tail" : std::to_string(s.tail) + " tail");
+
+            for(size_t n = 0; n < notes.size(); n++)
+                out += (n == 0 ? " (" : ", ") + notes[n];
+            if(!notes.empty())
+                out += ")";
+        }
+        out += "\n";
+    }
+
+    //recursion and costs, per arm counting the guards tested before it:
+    //----------------
+    std::unordered_map<ExpressionHandle, NodeCost> costs = node_costs(ast, plan, plans);
+    uint64_t minNodes = MAX_COST, maxNodes = 0, maxRecursive = 0;
+    bool allTail = true;
+    std::vector<ExpressionHandle> roots;
+    for(const auto& arm : func->map)
+    {
+        if(!is_otherwise(ast, arm.second))
+            roots.push_back(arm.second);
+
+        std::vector<ExpressionHandle> armRoots = roots;
+        armRoots.push_back(arm.first);
+        NodeCost cost = roots_cost(ast, armRoots, costs);
+        minNodes = std::min(minNodes, cost.nodes);
+        maxNodes = std::max(maxNodes, cost.nodes);
+        maxRecursive = std::max(maxRecursive, cost.recursiveCalls);
+
+        const Expression& body = unwrap_temps(ast, arm.first);
+        const bool tail = body.type == Expression::FUNCTION && named_function(ast, body) >= 0 && plans[named_function(ast, body)].component == plan.component;
+        allTail &= cost.recursiveCalls == 0 || (cost.recursiveCalls == 1 && tail);
+    }
+
+    out += "    recursion: ";
+    if(!plan.recursive)
+        out += "none";
+    else if(maxRecursive >= 2)
+    {
+        out += "tree, up to " + std::to_string(maxRecursive) + " recursive calls per call";
+        hotspots.push_back(func->name);
+    }
+    else
+        out += allTail ? "tail" : "linear";
+
+    if(plan.recursive)
+    {
+        std::vector<std::string> others;
+        for(size_t g = 0; g < plans.size(); g++)
+            if((int32_t)g != f && plans[g].component == plan.component)
+                others.push_back(ast->functions[g].name);
+        for(size_t i = 0; i < others.size(); i++)
+            out += (i == 0 ? ", mutual with " : ", ") + others[i];
+    }
+    out += "\n";
+
+    out += "    types:";
+    for(size_t i = 0; i < func->params.size(); i++)
+        out += " " + func->params[i] + " " + type_text(plan.params[i]) + ",";
+    out += " result " + type_text(plan.result) + "\n";
+
+    out += "    cost: ";
+    if(numArms == 0)
+        out += "0";
+    else if(minNodes == maxNodes)
+        out += std::to_string(maxNodes);
+    else
+        out += std::to_string(minNodes) + " to " + std::to_string(maxNodes);
+    out += " nodes per call, not counting callees\n";
+
+    if(plan.recursive && maxRecursive >= 2)
+        out += "    hotspot: calls grow exponentially with the depth of the recursion\n";
+    out += "\n";
+}
+
+//------------------------------------------------------
+//non-static func definitions:
+
+std::string explain_program(AST* ast)
+{
+    std::vector<FunctionPlan> plans(ast->functions.size());
+    for(size_t f = 0; f < ast->functions.size(); f++)
+    {
+        if(!ast->functions[f].parsed)
+            continue;
+
+        FunctionPlan& plan = plans[f];
+        plan.nodes = post_order_nodes(ast, arm_roots(&ast->functions[f]));
+
+        std::unordered_map<ExpressionHandle, uint32_t> positions;
+        for(uint32_t i = 0; i < plan.nodes.size(); i++)
+        {
+            positions[plan.nodes[i]] = i;
+            plan.firstChild.push_back((uint32_t)plan.children.size());
+
+            Expression exp = ast->get_exp(plan.nodes[i]);
+            for_each_child(exp, [&](ExpressionHandle& child) { plan.children.push_back(positions.at(child)); });
+            if(exp.type != Expression::FUNCTION)
+                continue;
+
+            int32_t callee = named_function(ast, exp);
+            if(callee >= 0 && std::find(plan.callees.begin(), plan.callees.end(), callee) == plan.callees.end())
+                plan.callees.push_back(callee);
+        }
+
+        for(const auto& arm : ast->functions[f].map)
+            plan.bodies.push_back(positions.at(arm.first));
+    }
+
+    for(size_t f = 0; f < plans.size(); f++)
+        for(int32_t callee : plans[f].callees)
+            plans[callee].callers.push_back((int32_t)f);
+
+    find_components(plans);
+    infer_types(ast, plans);
+
+    std::string out;
+    std::vector<std::string> hotspots;
+    for(size_t f = 0; f < ast->functions.size(); f++)
+        explain_function(ast, (int32_t)f, plans, out, hotspots);
+
+    out += "hotspots:";
+    for(size_t i = 0; i < hotspots.size(); i++)
+        out += (i > 0 ? ", " : " ") + hotspots[i] + " (tree recursion)";
+    if(hotspots.empty())
+        out += " none";
+    out += "\n";
+    return out;
+}
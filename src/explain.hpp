@@ -0,0 +1,24 @@
+#ifndef OPAL_EXPLAIN_H
+#define OPAL_EXPLAIN_H
+
+#include "ast.hpp"
+#include <string>
+
+//------------------------------------------------------
+//execution plans:
+//
+//a plan describes every function of a loaded program as the tree walker will run it,
+//after the load-time passes: its arms and how their guards are dispatched, where its
+//calls go and which are tail calls, the shape of its recursion, the types its params
+//and result can take, and how many nodes a call evaluates, not counting its callees.
+//functions making more than one recursive call per call are flagged as hotspots, since
+//their calls grow exponentially with the depth of the recursion
+//
+//types are inferred from the literals and operators of the program, main's args and
+//those of functions nothing calls being taken as any number or array
+
+//the text of the plan. functions that are still unparsed are only listed, so load with
+//LoadOptions::lazy off to see them all
+std::string explain_program(AST* ast);
+
+#endif
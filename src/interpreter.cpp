@@ -1,279 +1,195 @@
 #include "interpreter.hpp"
+#include "parser.hpp"
+#include "stats.hpp"
+#include "value.hpp"
+#include "output.hpp"
+#include "closure.hpp"
+#include "optimizer.hpp"
+#include "arrays.hpp"
+#include "result_cache.hpp"
 #include <math.h>
+#include <errno.h>
+#include <stdlib.h>
 
 #include <unordered_map>
 #include <algorithm>
 #include <iostream>
 
 //------------------------------------------------------
-//base runtime error:
 
-class RuntimeError : public std::exception 
-{
-protected:
-    std::string str;
-
-public:
-    RuntimeError(int32_t line, int32_t charIdx) : std::exception()
-    {
-        str = "line " + std::to_string(line) + ":" + std::to_string(charIdx) + " - ";
-    }
+//every call's frame lives on one contiguous stack: its args, pushed by the caller,
+//followed by its cse temps. frames are addressed by the index of their first slot,
+//so the stack can grow without invalidating them
+static thread_local ValueFrames valueStack;
+constexpr size_t VALUE_STACK_RESERVE = 1 << 16;
 
-    const char* what() const noexcept override
-    {
-        return str.c_str();
-    }
-};
+Value evaluate_function(Function* func, size_t frame, AST* ast);
+Value evaluate_expression(ExpressionHandle exp, size_t frame, AST* ast);
 
 //------------------------------------------------------
-//specific runtime errors:
-
-class RuntimeErrorFuncNotFound : public RuntimeError 
-{ 
-public:
-    RuntimeErrorFuncNotFound(std::string n, int32_t l, int32_t c) : RuntimeError(l, c) { str += "no function \"" + n + "\" found"; }
-};
 
-class RuntimeErrorIncorrectNumArgs : public RuntimeError 
-{ 
-public:
-    RuntimeErrorIncorrectNumArgs(std::string i, int32_t n, int32_t l, int32_t c) : RuntimeError(l, c) { str += "no overload of function \"" + i + "\" takes " + std::to_string(n) + " arguments"; }
-};
-
-class RuntimeErrorInvalidCondition : public RuntimeError
+//reads all of text as an int, or as a float if it isn't one that fits. false if it's neither
+static bool parse_number(const std::string& text, Value& number)
 {
-public:
-    RuntimeErrorInvalidCondition(int32_t l, int32_t c) : RuntimeError(l, c) { str += "invalid condition"; }
-};
+	const char* begin = text.c_str();
+	char* end;
 
-class RuntimeErrorInvalidOperator : public RuntimeError
-{
-public:
-    RuntimeErrorInvalidOperator(int32_t l, int32_t c) : RuntimeError(l, c) { str += "invalid operator"; }
-};
+	errno = 0;
+	const long long i = strtoll(begin, &end, 10);
+	if (end != begin && *end == '\0' && errno == 0)
+	{
+		number = Value((int64_t)i);
+		return true;
+	}
 
-class RuntimeErrorInvalidExpression : public RuntimeError
-{
-public:
-    RuntimeErrorInvalidExpression(int32_t l, int32_t c) : RuntimeError(l, c) { str += "invalid expression"; }
-};
+	const double f = strtod(begin, &end);
+	if (end == begin || *end != '\0')
+		return false;
 
-class RuntimeErrorInvalidVariable : public RuntimeError
-{
-public:
-	RuntimeErrorInvalidVariable(int32_t l, int32_t c) : RuntimeError(l, c) { str += "invalid variable"; }
-};
+	number = Value(f);
+	return true;
+}
 
-//------------------------------------------------------
 
-struct Value
+Value run_main(AST* ast, const std::vector<std::string>& args, ClosureProgram* closures, const EvalLimits& limits, ResultCache* cache)
 {
-	enum Type
-	{
-		INT,
-		FLOAT,
-		BOOL
-	} type;
-
-	union
-	{
-		float floatVal;
-		int64_t intVal;
-		bool boolVal;
-	};
-
-	float get_scalar() const
-	{
-		switch(type)
-		{
-		case INT:
-			return (float)intVal;
-			break;
-		case BOOL:
-			return (float)boolVal;
-			break;
-		case FLOAT:
-			return (float)floatVal;
-		}
-	}
-
-	int64_t get_int() const
+	OPAL_STAT_TIME(STAGE_RUN);
+	OPAL_EVAL_STAT_SCOPE();
+	EvalBudgetScope budget(limits);
+	valueBoxes.clear();
+	valueArrays.clear();
+	arrayElements.clear();
+	valueStack.clear();
+	valueStack.reserve(VALUE_STACK_RESERVE);
+
+	//cached results are keyed on the sources, so programs that weren't loaded from
+	//sources can't use them
+	ResultCacheScope resultScope(ast->sourceHash != 0 ? cache : nullptr, ast->sourceHash);
+	Value result;
+
+	Function* f = ast->find_function("main");
+	if (f == nullptr)
+		throw new RuntimeErrorFuncNotFound("main", 0, 0);
+	if (args.size() != f->params.size())
+		throw new RuntimeErrorIncorrectNumArgs(f->name, args.size(), f->line, 0);
+
+	std::vector<Value> values;
+	for (int i = 0; i < args.size(); i++)
 	{
-		switch(type)
+		Value array;
+		if (parse_array(args[i], array))
 		{
-		case INT:
-			return (int64_t)intVal;
-			break;
-		case BOOL:
-			return (int64_t)boolVal;
-			break;
-		case FLOAT:
-			return (int64_t)floorf(floatVal);
+			values.push_back(array);
+			continue;
 		}
-	}
 
-	Value()        { type = INT;   intVal   = 0; }
-	Value(int64_t i)   { type = INT;   intVal   = i; }
-	Value(float f) { type = FLOAT; floatVal = f; }
-	Value(bool b)  { type = BOOL;  boolVal  = b; }
-
-	Value operator+(const Value& other)
-	{
-		if(type == FLOAT || other.type == FLOAT)
-			return Value(get_scalar() + other.get_scalar());
-		else
-			return Value(get_int() + other.get_int());
-	}
-
-	Value operator-(const Value& other)
-	{
-		if(type == FLOAT || other.type == FLOAT)
-			return Value(get_scalar() - other.get_scalar());
-		else
-			return Value(get_int() - other.get_int());
-	}
-
-	Value operator*(const Value& other)
-	{
-		if(type == FLOAT || other.type == FLOAT)
-			return Value(get_scalar() * other.get_scalar());
-		else
-			return Value(get_int() * other.get_int());
-	}
-
-	Value operator/(const Value& other)
-	{
-		if(type == FLOAT || other.type == FLOAT)
-			return Value(get_scalar() / other.get_scalar());
-		else
-			return Value(get_int() / other.get_int());
-	}
-
-	Value operator%(const Value& other)
-	{
-		if(type == FLOAT || other.type == FLOAT)
-			return Value(fmodf(get_scalar(), other.get_scalar()));
-		else
-			return Value(get_int() % other.get_int());
-	}
-
-	Value operator==(const Value& other)
-	{
-		return Value(get_scalar() == other.get_scalar());
-	}
-
-	Value operator>(const Value& other)
-	{
-		return Value(get_scalar() > other.get_scalar());
-	}
-
-	Value operator<(const Value& other)
-	{
-		return Value(get_scalar() < other.get_scalar());
-	}
-
-	Value operator>=(const Value& other)
-	{
-		return Value(get_scalar() >= other.get_scalar());
+		Value number;
+		if (!parse_number(args[i], number))
+			throw new RuntimeErrorInvalidMainArgument(args[i], f->nameLine, f->nameCharIdx);
+		values.push_back(number);
 	}
 
-	Value operator<=(const Value& other)
+	if (closures != nullptr)
+		result = call_closure(find_compiled(closures, "main"), values.data(), values.size());
+	else
 	{
-		return Value(get_scalar() <= other.get_scalar());
+		valueStack.insert(valueStack.end(), values.begin(), values.end());
+		result = evaluate_function(f, 0, ast);
 	}
 
-	Value to(const Value& other)
-	{
-		if(type != FLOAT && other.type != FLOAT)
-		{
-			int64_t result = 1;
-			for(int i = 0; i < other.get_int(); i++)
-				result *= get_int();
+	return result;
+}
 
-			return Value(result);
-		}
-		else
-			return Value(powf(get_scalar(), other.get_scalar()));
-	}
-};
+std::string run(AST* ast, std::vector<std::string> args)
+{
+	Value result = run_main(ast, args);
+	std::string text(max_value_chars(result), '\0');
+	text.resize(format_value(result, &text[0]));
+	return text;
+}
 
 //------------------------------------------------------
 
-//------------------------------------------------------
+//evaluates the call to func whose args are pushed from frame on
+static Value evaluate_arms(Function* func, size_t frame, AST* ast)
+{
+	if(!func->parsed)
+		parse_lazy_function(ast, func);
 
-Value evaluate_function(Function* func, const std::vector<Value>& args, AST* ast);
-Value evaluate_expression(ExpressionHandle exp, const std::unordered_map<std::string, Value>& params, AST* ast);
+	//hot functions are re-optimized, and the call switches to the new arms
+	if(!func->hot && ast->passes.hotThreshold > 0 && ++func->calls >= (uint32_t)ast->passes.hotThreshold)
+		optimize_hot_function(ast, func);
 
-//------------------------------------------------------
+	const auto& arms = func->hot ? func->hotMap : func->map;
+	const int32_t numTemps = func->hot ? func->hotTemps : func->numTemps;
 
-std::string run(AST* ast, std::vector<std::string> args)
-{
-	for (Function f : ast->functions)
+	//setup frame, the args are already pushed:
+	//----------------
+	size_t numArgs = valueStack.size() - frame;
+	if(numArgs != func->params.size())
+		throw new RuntimeErrorIncorrectNumArgs(func->name, numArgs, func->line, 0);
+	
+	valueStack.resize(frame + numArgs + numTemps, Value::from_bits(Value::EMPTY_BITS));
+	
+	//find correct expression to evaluate by evaluating conditions:
+	//----------------
+	const BoxMark boxMark = mark_boxes();
+	Value result((int64_t)0);
+	for(int i = 0; i < arms.size(); i++)
 	{
-		if (f.name == "main")
+		//nodes are shared between arms, so errors are moved to where they occurred in this one
+		try
 		{
-			std::vector<Value> values;
-			if (args.size() != f.params.size())
-				return "args size mismatch eror";
+			Value condResult = evaluate_expression(arms[i].second, frame, ast);
+			if(!condResult.is_bool())
+				throw new RuntimeErrorInvalidCondition(ast->get_exp(arms[i].second).line, ast->get_exp(arms[i].second).charIdx);
 
-			for (int i = 0; i < args.size(); i++)
+			if(condResult.is_true())
 			{
-				try
+				if(ast->passes.countArms)
 				{
-					std::stoi(args[i]);
-					values.push_back(Value((int64_t)std::stoi(args[i])));
+					if(func->armHits.size() != arms.size())
+						func->armHits.resize(arms.size());
+					func->armHits[i]++;
 				}
-				catch (std::exception e)
-				{
-					values.push_back(Value(std::stof(args[i])));
-				}
-			}
 
-			Value result = evaluate_function(&f, values, ast);
-			switch (result.type)
+				result = evaluate_expression(arms[i].first, frame, ast);
+				break;
+			}
+		}
+		catch(RuntimeError* error)
+		{
+			if(!error->located)
 			{
-			case Value::FLOAT:
-				return std::to_string(result.floatVal);
-			case Value::INT:
-				return std::to_string(result.intVal);
-			case Value::BOOL:
-				return std::to_string(result.boolVal);
+				error->located = true;
+				int32_t line = error->line, charIdx = error->charIdx;
+				if(ast->relocate(arms[i], line, charIdx))
+					error->set_position(line, charIdx);
 			}
+			throw;
 		}
 	}
 
-	return "unknown error";
+	valueStack.resize(frame);
+	return release_boxes(boxMark, result);
 }
 
-//------------------------------------------------------
-
-Value evaluate_function(Function* func, const std::vector<Value>& args, AST* ast)
+Value evaluate_function(Function* func, size_t frame, AST* ast)
 {
-	//setup params:
-	//----------------
-	if(args.size() != func->params.size())
-		throw new RuntimeErrorIncorrectNumArgs(func->name, args.size(), func->line, 0);
-	
-	std::unordered_map<std::string, Value> params;
-	for(int i = 0; i < args.size(); i++)
-		params[func->params[i]] = args[i];
-	
-	//find correct expression to evaluate by evaluating conditions:
-	//----------------
-	for(int i = 0; i < func->map.size(); i++)
-	{
-		Value condResult = evaluate_expression(func->map[i].second, params, ast);
-		if(condResult.type != Value::BOOL)
-			throw new RuntimeErrorInvalidCondition(ast->get_exp(func->map[i].second).line, ast->get_exp(func->map[i].second).charIdx);
-		
-		if(condResult.boolVal)
-			return evaluate_expression(func->map[i].first, params, ast);
-	}
+	OPAL_EVAL_STAT_INC(calls);
+	OPAL_EVAL_STAT_DEPTH();
+	charge_call(func->line);
+
+	if(resultCalls.cache == nullptr)
+		return evaluate_arms(func, frame, ast);
 
-	return Value((int64_t)0);
+	//a cached result leaves the args pushed
+	Value result = cached_call(func, valueStack.data() + frame, (int32_t)(valueStack.size() - frame), [&] { return evaluate_arms(func, frame, ast); });
+	valueStack.resize(frame);
+	return result;
 }
 
-Value evaluate_expression(ExpressionHandle exp, const std::unordered_map<std::string, Value>& params, AST* ast)
+Value evaluate_expression(ExpressionHandle exp, size_t frame, AST* ast)
 {
 	switch(ast->get_exp(exp).type)
 	{
@@ -282,10 +198,13 @@ Value evaluate_expression(ExpressionHandle exp, const std::unordered_map<std::st
 		Value l, r;
 		if (ast->get_exp(exp).op.op != OTHERWISE)
 		{
-			l = evaluate_expression(ast->get_exp(exp).op.left, params, ast);
-			r = evaluate_expression(ast->get_exp(exp).op.right, params, ast);
+			l = evaluate_expression(ast->get_exp(exp).op.left, frame, ast);
+			r = evaluate_expression(ast->get_exp(exp).op.right, frame, ast);
+			if (l.is_array() || r.is_array())
+				return array_operator(ast->get_exp(exp).op.op, l, r, ast->get_exp(exp).line, ast->get_exp(exp).charIdx);
 		}
 
+		OPAL_EVAL_STAT_INC(operators[ast->get_exp(exp).op.op]);
 		switch(ast->get_exp(exp).op.op)
 		{
 		case ADD:
@@ -318,40 +237,55 @@ Value evaluate_expression(ExpressionHandle exp, const std::unordered_map<std::st
 	}
 	case Expression::FUNCTION:
 	{
-		for (int i = 0; i < ast->functions.size(); i++)
+		//the callee is looked up by name once, functions only ever being added after it
+		Function* funct = nullptr;
+		if (ast->get_exp(exp).func.target >= 0)
+			funct = &ast->functions[ast->get_exp(exp).func.target];
+		else if ((funct = ast->find_function(ast->get_exp(exp).func.name)) != nullptr)
+			ast->get_exp(exp).func.target = (int32_t)(funct - ast->functions.data());
+
+		//builtins are only called when no function of the program shadows them
+		const Builtin* builtin = nullptr;
+		if (funct == nullptr && (builtin = find_builtin(ast->get_exp(exp).func.name)) == nullptr)
+			throw new RuntimeErrorFuncNotFound(ast->get_exp(exp).func.name, ast->get_exp(exp).line, ast->get_exp(exp).charIdx);
+
+		//each arg is pushed once evaluated, so calls made by later args stack above it
+		size_t args = valueStack.size();
+		for (int i = 0; i < ast->get_exp(exp).func.numParams; i++)
 		{
-			if (ast->get_exp(exp).func.name == ast->functions[i].name)
-			{
-				Function* funct;
-				for (int i = 0; i < ast->functions.size(); i++)
-				{
-					if (ast->functions[i].name == ast->get_exp(exp).func.name)
-					{
-						funct = &ast->functions[i];
-					}
-				}
-				std::vector<Value> values;
-				for (int i = 0; i < ast->get_exp(exp).func.numParams; i++)
-				{
-					values.push_back(evaluate_expression(ast->get_exp(exp).func.params[i], params, ast));
-				}
-				return evaluate_function(funct, values, ast);
-			}
+			Value arg = evaluate_expression(ast->get_exp(exp).func.params[i], frame, ast);
+			valueStack.push_back(arg);
 		}
-		throw new RuntimeErrorFuncNotFound(ast->get_exp(exp).func.name, ast->get_exp(exp).line, ast->get_exp(exp).charIdx);
+		if (builtin != nullptr)
+		{
+			Value result = call_builtin(builtin, valueStack.data() + args, valueStack.size() - args, ast->get_exp(exp).line, ast->get_exp(exp).charIdx);
+			valueStack.resize(args);
+			return result;
+		}
+		return evaluate_function(funct, args, ast);
 	}
     case Expression::VARIABLE:
 	{
-		if (params.find(ast->get_exp(exp).var.name) == params.end())
+		if (ast->get_exp(exp).var.slot < 0)
 		{
 			throw new RuntimeErrorInvalidVariable(ast->get_exp(exp).line, ast->get_exp(exp).charIdx);
 		}
-		return params.at(ast->get_exp(exp).var.name);
+		return valueStack[frame + ast->get_exp(exp).var.slot];
+	}
+	case Expression::TEMP:
+	{
+		size_t slot = frame + ast->get_exp(exp).temp.slot;
+		if (valueStack[slot].bits == Value::EMPTY_BITS)
+		{
+			Value temp = evaluate_expression(ast->get_exp(exp).temp.exp, frame, ast);
+			valueStack[slot] = temp;
+		}
+		return valueStack[slot];
 	}
     case Expression::INT_LITERAL:
 		return Value((int64_t) ast->get_exp(exp).intLit.val);
     case Expression::FLOAT_LITERAL:
-		return Value(ast->get_exp(exp).floatLit.val);
+		return Value((double) ast->get_exp(exp).floatLit.val);
 	default:
 		throw new RuntimeErrorInvalidExpression(ast->get_exp(exp).line, ast->get_exp(exp).charIdx);
 	}
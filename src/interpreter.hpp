@@ -2,7 +2,144 @@
 #define OPAL_INTERPRETER_H
 
 #include "ast.hpp"
+#include "value.hpp"
+#include "budget.hpp"
+#include <string>
+#include <exception>
 
+//------------------------------------------------------
+//base runtime error:
+
+class RuntimeError : public std::exception 
+{
+protected:
+    std::string str;
+    size_t positionLength; //of the "line l:c - " str starts with
+
+public:
+    int32_t line;
+    int32_t charIdx;
+
+    //set once the innermost arm the error passed through moved it to where the node
+    //that raised it occurred in that arm, see AST::relocate
+    bool located = false;
+
+    RuntimeError(int32_t line, int32_t charIdx) : std::exception(), line(line), charIdx(charIdx)
+    {
+        str = "line " + std::to_string(line) + ":" + std::to_string(charIdx) + " - ";
+        positionLength = str.size();
+    }
+
+    void set_position(int32_t l, int32_t c)
+    {
+        std::string position = "line " + std::to_string(l) + ":" + std::to_string(c) + " - ";
+        str.replace(0, positionLength, position);
+        positionLength = position.size();
+        line = l;
+        charIdx = c;
+    }
+
+    const char* what() const noexcept override
+    {
+        return str.c_str();
+    }
+};
+
+//------------------------------------------------------
+//specific runtime errors:
+
+class RuntimeErrorFuncNotFound : public RuntimeError 
+{ 
+public:
+    RuntimeErrorFuncNotFound(std::string n, int32_t l, int32_t c) : RuntimeError(l, c) { str += "no function \"" + n + "\" found"; }
+};
+
+class RuntimeErrorIncorrectNumArgs : public RuntimeError 
+{ 
+public:
+    RuntimeErrorIncorrectNumArgs(std::string i, int32_t n, int32_t l, int32_t c) : RuntimeError(l, c) { str += "no overload of function \"" + i + "\" takes " + std::to_string(n) + " arguments"; }
+};
+
+class RuntimeErrorInvalidCondition : public RuntimeError
+{
+public:
+    RuntimeErrorInvalidCondition(int32_t l, int32_t c) : RuntimeError(l, c) { str += "invalid condition"; }
+};
+
+class RuntimeErrorInvalidOperator : public RuntimeError
+{
+public:
+    RuntimeErrorInvalidOperator(int32_t l, int32_t c) : RuntimeError(l, c) { str += "invalid operator"; }
+};
+
+class RuntimeErrorInvalidExpression : public RuntimeError
+{
+public:
+    RuntimeErrorInvalidExpression(int32_t l, int32_t c) : RuntimeError(l, c) { str += "invalid expression"; }
+};
+
+class RuntimeErrorInvalidVariable : public RuntimeError
+{
+public:
+	RuntimeErrorInvalidVariable(int32_t l, int32_t c) : RuntimeError(l, c) { str += "invalid variable"; }
+};
+
+class RuntimeErrorInvalidArgument : public RuntimeError
+{
+public:
+    RuntimeErrorInvalidArgument(std::string n, int32_t l, int32_t c) : RuntimeError(l, c) { str += "invalid argument to builtin \"" + n + "\""; }
+};
+
+class RuntimeErrorArrayLengths : public RuntimeError
+{
+public:
+    RuntimeErrorArrayLengths(size_t a, size_t b, int32_t l, int32_t c) : RuntimeError(l, c) { str += "arrays of length " + std::to_string(a) + " and " + std::to_string(b) + " don't match"; }
+};
+
+//an arg given to main that reads as neither a number nor an array
+class RuntimeErrorInvalidMainArgument : public RuntimeError
+{
+public:
+    RuntimeErrorInvalidMainArgument(std::string a, int32_t l, int32_t c) : RuntimeError(l, c) { str += "argument \"" + a + "\" is not a number or an array"; }
+};
+
+//arrays only live within an evaluation, so they can't be returned through opal_call
+class RuntimeErrorArrayResult : public RuntimeError
+{
+public:
+    RuntimeErrorArrayResult(std::string n, int32_t l, int32_t c) : RuntimeError(l, c) { str += "function \"" + n + "\" returned an array"; }
+};
+
+//an evaluation ran out of the fuel or time given to it by its EvalLimits, was cancelled,
+//or nested calls deeper than the native stack allows
+class RuntimeErrorBudgetExceeded : public RuntimeError
+{
+public:
+    enum Reason
+    {
+        FUEL,
+        DEADLINE,
+        CANCELLED,
+        DEPTH
+    } reason;
+
+    RuntimeErrorBudgetExceeded(Reason r, int32_t l, int32_t c) : RuntimeError(l, c), reason(r)
+    {
+        static const char* const messages[] = {"out of fuel", "deadline exceeded", "cancelled", "call depth exceeded"};
+        str += messages[r];
+    }
+};
+
+//------------------------------------------------------
+
+struct ClosureProgram;
+struct ResultCache;
+
+//evaluates main with args read as numbers. a boxed result stays valid until the next
+//evaluation on the same thread. with closures given, main runs on the closure tier.
+//with a cache given, expensive calls (result_cache.hpp) aren't evaluated again for args
+//it has a result for, so limits only apply to new evaluations
+Value run_main(AST* ast, const std::vector<std::string>& args, ClosureProgram* closures = nullptr, const EvalLimits& limits = EvalLimits(), ResultCache* cache = nullptr);
 std::string run(AST* ast, std::vector<std::string> args);
 
 #endif
\ No newline at end of file
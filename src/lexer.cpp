@@ -1,55 +1,22 @@
 #include "lexer.hpp"
+#include "stats.hpp"
 #include <fstream>
 #include <algorithm>
 #include <string.h>
+#include <stdlib.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-static std::vector<std::string> sorted_operators() {
-    std::vector<std::string> ops;
-    for (auto op : OPERATORS) {
-        ops.push_back(op.first);
-    }
-    std::sort(ops.begin(), ops.end());
-    reverse(ops.begin(), ops.end());
-    return ops;
-}
-
-static std::vector<std::string> sorted_separators() {
-    std::vector<std::string> seps;
-    for (auto sep : SEPARATORS) {
-        seps.push_back(sep.first);
-    }
-    std::sort(seps.begin(), seps.end());
-    std::reverse(seps.begin(), seps.end());
-    return seps;
-}
-
-void free_tokens(std::vector<Token> tokens) {
-    for (Token t : tokens) {
+void free_tokens(TokenList& tokens) {
+    for (Token& t : tokens) {
         if (t.type == Token::IDENTIFIER) {
-            delete t.iden;
+            free_identifier(t.iden);
         }
     }
+    tokens.clear();
 }
 
-static char* read_n_bytes(std::ifstream& file, int n) {
-    char* bytes = (char*)malloc(n);
-    for (int i = 0; i < n; i++) {
-        if (file.peek() == EOF) return bytes;
-        bytes[i] = file.get();
-    }
-    return bytes;
-}
-
-static void free_read_bytes(char* bytes) {
-    free(bytes);
-}
-
-static int MAX_OP_LEN = sorted_operators().front().length();
-static int MIN_OP_LEN = sorted_operators().back().length();
-
-static int MAX_SEP_LEN = sorted_separators().front().length();
-static int MIN_SEP_LEN = sorted_separators().back().length();
-
 class LexError : public std::exception 
 {
 protected:
@@ -73,150 +40,312 @@ public:
     LexErrorInvalidToken(int32_t l, int32_t c) : LexError(l, c) { str += "invalid token"; }
 };
 
-std::vector<Token> lex_file(std::string fileName) {
-    std::vector<Token> list;
+//------------------------------------------------------
+//character classes:
 
-    std::ifstream file(fileName);
-    if (!file.good())
-        return std::vector<Token>();
+enum CharClass : uint8_t {
+    CHAR_SPACE = 1, // whitespace other than '\n'
+    CHAR_DIGIT = 2,
+    CHAR_IDEN_START = 4,
+    CHAR_IDEN = 8
+};
 
-    int32_t curLine = 1;
-    int32_t curCharIdx = 0;
+struct CharClassTable {
+    uint8_t classes[256];
+};
 
-    beginning:
-    while (file.peek() != EOF) {
-        // REMOVE ALL WHITESPACE BEFORE POTENTIAL NEW LINE
-        while (std::isspace(file.peek()) && file.peek() != '\n') {
-            file.get();
-        }
-        
-        // CHECK FOR A NEW LINE
-        while (file.peek() == '\n') {
-            file.get();
-            if (list.size() > 0 && list.back().type != Token::Type::NEWLINE) {
-                list.push_back(Token(Token::Type::NEWLINE, curLine, curCharIdx));
-            }
-            curLine++;
-            goto beginning;
+static constexpr CharClassTable make_char_classes() {
+    CharClassTable table = {};
+    for (int32_t c = 0; c < 256; c++) {
+        bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        bool digit = c >= '0' && c <= '9';
+        if (c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r') table.classes[c] |= CHAR_SPACE;
+        if (digit) table.classes[c] |= CHAR_DIGIT;
+        if (alpha || c == '_') table.classes[c] |= CHAR_IDEN_START;
+        if (alpha || digit || c == '_') table.classes[c] |= CHAR_IDEN;
+    }
+    return table;
+}
+
+static constexpr CharClassTable CHAR_CLASSES = make_char_classes();
+
+static inline bool has_class(char c, uint8_t charClass) {
+    return (CHAR_CLASSES.classes[(unsigned char)c] & charClass) != 0;
+}
+
+//runs of one class are scanned 16 bytes at a time where SSE2 is available (every x86-64),
+//and a byte at a time for the rest
+#if defined(__SSE2__)
+// bytes of block within [lo, hi]: (b - lo) <= (hi - lo), unsigned
+static inline __m128i bytes_in_range(__m128i block, char lo, char hi) {
+    __m128i shifted = _mm_sub_epi8(block, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_subs_epu8(shifted, _mm_set1_epi8((char)(hi - lo))), _mm_setzero_si128());
+}
+
+static inline __m128i class_mask(__m128i block, uint8_t charClass) {
+    switch (charClass) {
+    case CHAR_SPACE:
+        return _mm_or_si128(_mm_andnot_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\n')), bytes_in_range(block, '\t', '\r')),
+                            _mm_cmpeq_epi8(block, _mm_set1_epi8(' ')));
+    case CHAR_DIGIT:
+        return bytes_in_range(block, '0', '9');
+    default: // CHAR_IDEN
+        return _mm_or_si128(_mm_or_si128(bytes_in_range(block, 'a', 'z'), bytes_in_range(block, 'A', 'Z')),
+                            _mm_or_si128(bytes_in_range(block, '0', '9'), _mm_cmpeq_epi8(block, _mm_set1_epi8('_'))));
+    }
+}
+#endif
+
+// the first char at or after cur that isn't of charClass
+static inline const char* skip_class(const char* cur, const char* end, uint8_t charClass) {
+#if defined(__SSE2__)
+    while (end - cur >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)cur);
+        uint32_t outside = ~(uint32_t)_mm_movemask_epi8(class_mask(block, charClass)) & 0xFFFF;
+        if (outside != 0)
+            return cur + __builtin_ctz(outside);
+        cur += 16;
+    }
+#endif
+    while (cur < end && has_class(*cur, charClass)) cur++;
+    return cur;
+}
+
+//------------------------------------------------------
+//operator and separator spellings:
+//
+//spellings are numbered operators first, then separators. every spelling is indexed by
+//its first byte, longest first, so at most a couple are compared at any char, and a
+//longer one wins over its prefix (">=" over ">"), as it must
+
+constexpr int32_t NUM_SPELLINGS = IMPORT + 1 + CLOSE_BRACKET + 1;
+constexpr int32_t MAX_SPELLINGS_PER_BYTE = 4;
+
+static constexpr const char* spelling_text(int32_t spelling) {
+    return spelling <= IMPORT ? OPERATOR_SPELLINGS[spelling] : SEPARATOR_SPELLINGS[spelling - IMPORT - 1];
+}
+
+static constexpr int32_t spelling_length(int32_t spelling) {
+    int32_t length = 0;
+    while (spelling_text(spelling)[length] != '\0') length++;
+    return length;
+}
+
+struct SpellingTable {
+    int8_t byFirstByte[256][MAX_SPELLINGS_PER_BYTE]; // -1 terminated
+    int32_t lengths[NUM_SPELLINGS];
+};
+
+static constexpr SpellingTable make_spelling_table() {
+    SpellingTable table = {};
+    for (int32_t c = 0; c < 256; c++)
+        for (int32_t i = 0; i < MAX_SPELLINGS_PER_BYTE; i++)
+            table.byFirstByte[c][i] = -1;
+
+    for (int32_t spelling = 0; spelling < NUM_SPELLINGS; spelling++) {
+        table.lengths[spelling] = spelling_length(spelling);
+
+        int8_t* candidates = table.byFirstByte[(unsigned char)spelling_text(spelling)[0]];
+        int32_t count = 0;
+        while (candidates[count] >= 0) count++;
+        if (count == MAX_SPELLINGS_PER_BYTE - 1)
+            throw "too many spellings share a first byte"; // fails the build
+
+        // insert, keeping longer spellings first
+        int32_t i = count;
+        for (; i > 0 && table.lengths[candidates[i - 1]] < table.lengths[spelling]; i--)
+            candidates[i] = candidates[i - 1];
+        candidates[i] = (int8_t)spelling;
+    }
+    return table;
+}
+
+static constexpr SpellingTable SPELLINGS = make_spelling_table();
+
+// the spelling source continues with at cur, or -1
+static inline int32_t match_spelling(const char* cur, const char* end) {
+    const int8_t* candidates = SPELLINGS.byFirstByte[(unsigned char)*cur];
+    for (int32_t i = 0; candidates[i] >= 0; i++) {
+        int32_t length = SPELLINGS.lengths[candidates[i]];
+        if (end - cur >= length && memcmp(cur, spelling_text(candidates[i]), length) == 0)
+            return candidates[i];
+    }
+    return -1;
+}
+
+//------------------------------------------------------
+//lexing:
+
+//identifiers are copied into blocks of at least this many bytes
+static constexpr size_t IDENTIFIER_BLOCK_SIZE = 4096;
+
+const Token TokenStream::EMPTY(Token::EMPTY, 0, 0);
+
+TokenStream::TokenStream(const char* source, size_t length, int32_t firstLine)
+    : batch(BATCH_SIZE, EMPTY), cur(source), end(source + length), lineStart(source), curLine(firstLine) {
+    window = batch.data();
+}
+
+TokenStream::TokenStream(const Token* begin, const Token* end) : window(begin), count(end - begin) {}
+
+TokenStream::~TokenStream() {
+    OPAL_STAT_ADD(tokens, numLexed);
+}
+
+//keeps the unconsumed tokens and lexes up to a batch after them
+void TokenStream::refill() {
+    if (cur == end) return;
+
+    Token* tokens = batch.data();
+    for (size_t i = 0; i < count; i++) {
+        tokens[i] = tokens[head + i];
+    }
+    head = 0;
+
+    while (count < BATCH_SIZE && lex_token(tokens[count])) {
+        lastType = tokens[count].type;
+        count++;
+        numLexed++;
+    }
+}
+
+char* TokenStream::store_identifier(const char* iden, size_t length) {
+    if (arena.empty() || arenaUsed + length + 1 > arena.back().bytes.size()) {
+        // reuse the oldest block once nothing lexed into it can still be in use
+        const size_t consumed = numLexed - count;
+        if (!arena.empty() && arena.front().lastToken + BATCH_SIZE <= consumed && arena.front().bytes.size() > length) {
+            IdentifierBlock block = std::move(arena.front());
+            arena.pop_front();
+            arena.push_back(std::move(block));
+        } else {
+            arena.emplace_back();
+            arena.back().bytes.resize(std::max(IDENTIFIER_BLOCK_SIZE, length + 1));
         }
+        arenaUsed = 0;
+    }
 
-        // IGNORE ANY WHITESPACE
-        while (std::isspace(file.peek())) {
-            file.get();
+    char* name = arena.back().bytes.data() + arenaUsed;
+    memcpy(name, iden, length);
+    name[length] = '\0';
+    arenaUsed += length + 1;
+    arena.back().lastToken = numLexed;
+    return name;
+}
+
+//lexes the next token into token, false once the source runs out
+bool TokenStream::lex_token(Token& token) {
+    auto newline = [&]() {
+        bool repeated = lastType == Token::NEWLINE || lastType == Token::EMPTY;
+        if (!repeated) {
+            token = Token(Token::Type::NEWLINE, curLine, (int32_t)(cur - lineStart));
         }
+        cur++;
+        curLine++;
+        lineStart = cur;
+        return !repeated;
+    };
 
-        // COMMENTS
-        if(file.peek() == '?') {
-            while(true) {
-                // case: end
-                if (file.peek() == '\n') {
-                    file.get();
-                    if (list.size() > 0 && list.back().type != Token::Type::NEWLINE) {
-                        list.push_back(Token(Token::Type::NEWLINE, curLine, curCharIdx));
-                    }
-                    curLine++;
-                    goto beginning;
-                }
-                if(file.eof()) goto beginning;
+    while (cur < end) {
+        // REMOVE ALL WHITESPACE BEFORE POTENTIAL NEW LINE
+        cur = skip_class(cur, end, CHAR_SPACE);
+        if (cur >= end) break;
 
-                // case:?
-                file.get();
-            }
+        int32_t curCharIdx = (int32_t)(cur - lineStart);
+
+        // CHECK FOR A NEW LINE
+        if (*cur == '\n') {
+            if (newline()) return true;
+            continue;
         }
 
-        // CHECK FOR AN OPERATOR
-        char test = file.peek();
-        size_t oldpos = file.tellg();
-        char* buffer = read_n_bytes(file, MAX_OP_LEN);
-        int i = MAX_OP_LEN;
-        while (i >= MIN_OP_LEN) {
-            char* bufstr = (char*)malloc(i+1);
-            for (int j = 0; j < i; j++) bufstr[j] = buffer[j];
-            bufstr[i] = '\0';
-            std::string buffrange(bufstr);
-            for (std::string op : sorted_operators()) {
-                if (op == buffrange) {
-                    list.push_back(Token(Token::OPERATOR, OPERATORS.at(op), curLine, curCharIdx));
-                    file.seekg(oldpos + op.length(), std::ios_base::beg);
-                    goto beginning;
-                }
-            }
-            file.seekg(oldpos, std::ios_base::beg);
-            free(bufstr);
-            i--;
+        // COMMENTS
+        if (*cur == '?') {
+            const char* lineEnd = (const char*)memchr(cur, '\n', end - cur);
+            cur = lineEnd != nullptr ? lineEnd : end;
+            if (cur < end && newline()) return true;
+            continue;
         }
-        free_read_bytes(buffer);
-
-        // CHECK FOR A SEPARATOR
-        oldpos = file.tellg();
-        char* buffer2 = read_n_bytes(file, MAX_SEP_LEN);
-        i = MAX_SEP_LEN;
-        while (i >= MIN_SEP_LEN) {
-            char* bufstr = (char*)malloc(i+1);
-            for (int j = 0; j < i; j++) bufstr[j] = buffer2[j];
-            bufstr[i] = '\0';
-            std::string buffrange(bufstr);
-
-            for (std::string sep : sorted_separators()) {
-                if (sep == buffrange) {
-                    list.push_back(Token(Token::SEPARATOR, SEPARATORS.at(sep), curLine, curCharIdx));
-                    file.seekg(oldpos + sep.length(), std::ios_base::beg);
-                    goto beginning;
-                }
+
+        // CHECK FOR AN OPERATOR OR A SEPARATOR
+        int32_t spelling = match_spelling(cur, end);
+        if (spelling >= 0) {
+            if (spelling <= IMPORT) {
+                token = Token(Token::OPERATOR, (Operator)spelling, curLine, curCharIdx);
+            } else {
+                token = Token(Token::SEPARATOR, (Separator)(spelling - IMPORT - 1), curLine, curCharIdx);
             }
-            file.seekg(oldpos, std::ios_base::beg);
-            free(bufstr);
-            i--;
+            cur += SPELLINGS.lengths[spelling];
+            return true;
         }
-        free_read_bytes(buffer2);
 
         // CHECK FOR AN INTEGER OR FLOAT LITERAL
-        bool is_number = std::isdigit(file.peek()) || file.peek() == '.' ? true : false;
-        bool is_int = true;
-        if (is_number) {
-            std::string acc = "";
-            while (is_int && !file.eof()) {
-                if (file.peek() == '.') {
-                    is_int = false;
-                    acc += file.get();
-                    break;
+        if (has_class(*cur, CHAR_DIGIT) || *cur == '.') {
+            const char* numStart = cur;
+            cur = skip_class(cur, end, CHAR_DIGIT);
+            if (cur < end && *cur == '.') {
+                cur = skip_class(cur + 1, end, CHAR_DIGIT);
+                if (cur - numStart == 1) {
+                    throw new LexErrorInvalidToken(curLine, curCharIdx);
                 }
-                if (std::isdigit(file.peek())) {
-                    char test = file.peek();
-                    acc += file.get();
-                } else {
-                    break;
+                token = Token(Token::Type::FLOAT_LITERAL, std::strtod(std::string(numStart, cur).c_str(), nullptr), curLine, curCharIdx);
+            } else {
+                int64_t val = 0;
+                for (const char* digit = numStart; digit < cur; digit++) {
+                    val = val * 10 + (*digit - '0');
+                    if (val > INT32_MAX) {
+                        throw new LexErrorInvalidToken(curLine, curCharIdx);
+                    }
                 }
+                token = Token(Token::Type::INT_LITERAL, (int32_t)val, curLine, curCharIdx);
             }
-            while (!is_int && !file.eof()) { // only executes for float literals
-                if (!std::isdigit(file.peek())) break;
-                acc += file.get();
-            }
-            if (acc == ".") {
-                throw new LexErrorInvalidToken(0, 0);
-            }
-            if (is_int) {
-                list.push_back(Token(Token::Type::INT_LITERAL, std::stoi(acc), curLine, curCharIdx));
-            } else if (is_int == false) {
-                list.push_back(Token(Token::Type::FLOAT_LITERAL, std::stof(acc), curLine, curCharIdx));
-            }
-            goto beginning;
+            return true;
         }
 
         // ANYTHING PAST THIS POINT IS AN IDENTIFIER
-        if (!(std::isalpha(file.peek()) || file.peek() == '_')) {
-            throw new LexErrorInvalidToken(0, 0);
-        } else {
-            std::string acc = "";
-            while (std::isalnum(file.peek()) || file.peek() == '_') {
-                acc += file.get();
-            }
-            char* acc_arr = new char[acc.length() + 1];
-            strcpy(acc_arr, acc.c_str());
-            list.push_back(Token(Token::IDENTIFIER, acc_arr, curLine, curCharIdx));
+        if (!has_class(*cur, CHAR_IDEN_START)) {
+            throw new LexErrorInvalidToken(curLine, curCharIdx);
         }
+
+        const char* idenStart = cur;
+        cur = skip_class(cur + 1, end, CHAR_IDEN);
+        token = Token(Token::IDENTIFIER, store_identifier(idenStart, cur - idenStart), curLine, curCharIdx);
+        return true;
+    }
+
+    cur = end;
+    return false;
+}
+
+TokenList lex_source(const char* source, size_t length, int32_t firstLine) {
+    TokenList list;
+    TokenStream stream(source, length, firstLine);
+
+    for (Token token = stream.next(); token.type != Token::EMPTY; token = stream.next()) {
+        if (token.type == Token::IDENTIFIER) {
+            token.iden = copy_identifier(token.iden);
+        }
+        list.push_back(token);
     }
 
-    file.close();
     return list;
-}
\ No newline at end of file
+}
+
+TokenList lex_file(std::string fileName) {
+    std::string source;
+    if (!read_file(fileName, source))
+        return TokenList();
+
+    return lex_source(source.data(), source.size(), 1);
+}
+
+bool read_file(const std::string& fileName, std::string& contents) {
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file.good())
+        return false;
+
+    file.seekg(0, std::ios::end);
+    contents.resize((size_t)file.tellg());
+    file.seekg(0, std::ios::beg);
+    file.read(&contents[0], contents.size());
+    return true;
+}
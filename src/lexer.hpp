@@ -1,11 +1,78 @@
 #ifndef OPAL_LEXER_H
 #define OPAL_LEXER_H
 
+#include <deque>
 #include <vector>
 #include <string>
 #include "token.hpp"
 
-void free_tokens(std::vector<Token> tokens);
-std::vector<Token> lex_file(std::string fileName);
+//pulls tokens out of source a batch at a time as they're consumed, so only a small
+//window of them is ever held. identifiers are copied into blocks owned by the stream,
+//and a block is reused once BATCH_SIZE tokens have been consumed past the last
+//identifier in it. so an identifier stays valid for BATCH_SIZE tokens after its own is
+//consumed, and whatever keeps one for longer copies it.
+//a stream can also replay tokens lexed earlier, like those of unparsed function bodies
+class TokenStream {
+public:
+    TokenStream(const char* source, size_t length, int32_t firstLine);
+    TokenStream(const Token* begin, const Token* end);
+    ~TokenStream();
 
-#endif
\ No newline at end of file
+    TokenStream(const TokenStream&) = delete;
+    TokenStream& operator=(const TokenStream&) = delete;
+
+    //the token ahead places after the next one, EMPTY past the end. newlines are never
+    //repeated, so ahead never needs to be above 1 to see past one
+    const Token& peek(size_t ahead = 0) {
+        if (ahead >= count) refill();
+        return ahead < count ? window[head + ahead] : EMPTY;
+    }
+
+    //consumes the next token, returning EMPTY without consuming anything past the end
+    Token next() {
+        const Token token = peek();
+        if (count > 0) {
+            head++;
+            count--;
+        }
+        return token;
+    }
+
+private:
+    static const Token EMPTY;
+    static constexpr size_t BATCH_SIZE = 64;
+
+    //window[head, head + count) are lexed but not yet consumed
+    const Token* window;
+    size_t head = 0;
+    size_t count = 0;
+
+    //lexing state, unused when replaying
+    TokenList batch;
+    const char* cur = nullptr;
+    const char* end = nullptr;
+    const char* lineStart = nullptr;
+    int32_t curLine = 0;
+    Token::Type lastType = Token::EMPTY;
+    size_t numLexed = 0;
+
+    //identifier blocks, oldest first, the last one being filled
+    struct IdentifierBlock {
+        std::vector<char, TrackedAllocator<char, MEM_IDENTIFIERS>> bytes;
+        size_t lastToken = 0; //index of the last token with an identifier in the block
+    };
+    std::deque<IdentifierBlock> arena;
+    size_t arenaUsed = 0;
+
+    void refill();
+    bool lex_token(Token& token);
+    char* store_identifier(const char* iden, size_t length);
+};
+
+//lexes all of source into a list whose identifiers are owned by the tokens
+void free_tokens(TokenList& tokens);
+TokenList lex_file(std::string fileName);
+TokenList lex_source(const char* source, size_t length, int32_t firstLine);
+bool read_file(const std::string& fileName, std::string& contents);
+
+#endif
@@ -0,0 +1,451 @@
+#include "loader.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "optimizer.hpp"
+#include "stats.hpp"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+#include <filesystem>
+#include <unordered_set>
+#include <string.h>
+
+//------------------------------------------------------
+//base load error:
+
+class LoadError : public std::exception 
+{
+protected:
+    std::string str;
+
+public:
+    LoadError(int32_t line, int32_t charIdx) : std::exception()
+    {
+        str = "line " + std::to_string(line) + ":" + std::to_string(charIdx) + " - ";
+    }
+
+    const char* what() const noexcept override
+    {
+        return str.c_str();
+    }
+};
+
+//------------------------------------------------------
+//specific load errors:
+
+class LoadErrorModuleNotFound : public LoadError 
+{
+public:
+    LoadErrorModuleNotFound(std::string n, std::string f, int32_t l, int32_t c) : LoadError(l, c) { str += "no module \"" + n + "\" found (imported by " + f + ")"; }
+};
+
+class LoadErrorProgramNotFound : public LoadError 
+{
+public:
+    LoadErrorProgramNotFound(std::string f) : LoadError(0, 0) { str += "no program \"" + f + "\" found"; }
+};
+
+class LoadErrorFunctionRedef : public LoadError 
+{
+public:
+    LoadErrorFunctionRedef(std::string n, std::string f, int32_t l, int32_t c) : LoadError(l, c) { str += "\"" + n + "\" function redefinition in " + f; }
+};
+
+//------------------------------------------------------
+//module cache:
+
+typedef std::unordered_map<std::string, AST*> ModuleCache;
+
+static std::mutex moduleMutex;
+static ModuleCache moduleCache;
+
+//------------------------------------------------------
+//helper func definitions:
+
+static bool is_identifier_char(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+//runs task(i) for every i in [0, count) on numThreads threads, including the calling one
+template<typename Task>
+static void parallel_for(size_t count, uint32_t numThreads, Task task)
+{
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for(size_t i = next++; i < count; i = next++)
+            task(i);
+    };
+
+    std::vector<std::thread> threads;
+    for(uint32_t i = 1; i < numThreads; i++)
+        threads.emplace_back(worker);
+
+    worker();
+    for(std::thread& t : threads)
+        t.join();
+}
+
+//errors are heap allocated and owned by whoever catches them, so those that are
+//never rethrown are deleted here
+static void delete_errors(std::vector<std::exception_ptr>& errors, size_t first)
+{
+    for(size_t i = first; i < errors.size(); i++)
+    {
+        if(!errors[i])
+            continue;
+
+        try
+        {
+            std::rethrow_exception(errors[i]);
+        }
+        catch(std::exception* e)
+        {
+            delete e;
+        }
+        catch(...)
+        {
+        }
+    }
+}
+
+//------------------------------------------------------
+//non-static func definitions:
+
+std::vector<SourceChunk> scan_functions(const char* source, size_t length)
+{
+    std::vector<SourceChunk> chunks;
+    chunks.push_back({0, 0, 1});
+
+    int32_t line = 1;
+    int32_t depth = 0;
+    for(size_t i = 0; i < length; i++)
+    {
+        switch(source[i])
+        {
+        case '\n':
+            line++;
+            break;
+        case '?': //comment, resume at the newline
+            while(i + 1 < length && source[i + 1] != '\n')
+                i++;
+            break;
+        case '{':
+            depth++;
+            break;
+        case '}':
+            depth--;
+            break;
+        case 'f':
+            if(depth == 0 && length - i >= 3 && memcmp(source + i, "fn ", 3) == 0 && (i == 0 || !is_identifier_char(source[i - 1])))
+            {
+                chunks.back().end = i;
+                chunks.push_back({i, 0, line});
+            }
+            break;
+        }
+    }
+
+    chunks.back().end = length;
+    return chunks;
+}
+
+AST* load_source(const char* source, size_t length, const LoadOptions& options)
+{
+    uint32_t numThreads = options.numThreads;
+    if(numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<SourceChunk> chunks = scan_functions(source, length);
+
+    //group neighbouring chunks into a few tasks per thread, so tiny functions
+    //don't pay for a task each but uneven ones still balance out:
+    //----------------
+    const size_t numTasks = std::min(chunks.size(), (size_t)numThreads * 4);
+    const size_t bytesPerTask = length / numTasks + 1;
+
+    std::vector<SourceChunk> tasks;
+    for(const SourceChunk& chunk : chunks)
+    {
+        if(tasks.empty() || tasks.back().end - tasks.back().begin >= bytesPerTask)
+            tasks.push_back(chunk);
+        else
+            tasks.back().end = chunk.end;
+    }
+
+    //parse every task into its own arena, lexing as the parser goes:
+    //----------------
+    std::vector<AST*> arenas(tasks.size(), nullptr);
+    std::vector<std::exception_ptr> errors(tasks.size());
+
+    parallel_for(tasks.size(), std::min((size_t)numThreads, tasks.size()), [&](size_t i)
+    {
+        try
+        {
+            TokenStream tokens(source + tasks[i].begin, tasks[i].end - tasks[i].begin, tasks[i].line);
+            arenas[i] = generate_ast(tokens, options.lazy);
+        }
+        catch(...)
+        {
+            errors[i] = std::current_exception();
+        }
+    });
+
+    //merge arenas in source order, reporting the first error in the file:
+    //----------------
+    AST* ast = new AST;
+    try
+    {
+        for(size_t i = 0; i < tasks.size(); i++)
+        {
+            if(errors[i])
+            {
+                delete_errors(errors, i + 1);
+                std::rethrow_exception(errors[i]);
+            }
+
+            merge_ast(ast, arenas[i]);
+        }
+    }
+    catch(...)
+    {
+        for(AST* arena : arenas)
+            if(arena != nullptr)
+                free_ast(arena);
+        free_ast(ast);
+        throw;
+    }
+
+    for(AST* arena : arenas)
+        free_ast(arena);
+
+    return ast;
+}
+
+AST* load_file(const std::string& fileName, const LoadOptions& options)
+{
+    std::string source;
+    if(!read_file(fileName, source))
+        return new AST;
+
+    return load_source(source.data(), source.size(), options);
+}
+
+//------------------------------------------------------
+//module loading:
+
+//returns the module at path in cache, loading it first if needed. nullptr if it doesn't
+//exist. with lazy, its function bodies are left for parse_bodies
+static AST* load_module(ModuleCache& cache, const std::string& path, const LoadOptions& options, bool lazy)
+{
+    auto it = cache.find(path);
+    if(it != cache.end())
+        return it->second;
+
+    std::string source;
+    if(!read_file(path, source))
+        return nullptr;
+
+    LoadOptions moduleOptions = options;
+    moduleOptions.lazy = lazy;
+
+    AST* module = load_source(source.data(), source.size(), moduleOptions);
+    module->passes = options.passes;
+    module->sourceHash = stable_hash(source.data(), source.size());
+    cache[path] = module;
+    return module;
+}
+
+//parses the bodies of module's functions, or only those in reachable when it isn't empty
+static void parse_bodies(AST* module, const std::unordered_set<const Function*>& reachable)
+{
+    for(Function& func : module->functions)
+        if(reachable.empty() || reachable.count(&func))
+            parse_lazy_function(module, &func);
+}
+
+//adds the names of every function called by func to calls
+static void collect_calls(AST* ast, const Function& func, std::vector<std::string>& calls)
+{
+    if(!func.parsed)
+    {
+        //unparsed bodies are cheaper to scan for "name(" than to parse
+        for(size_t i = func.bodyBegin; i < func.bodyEnd; i++)
+            if(ast->tokens[i].type == Token::IDENTIFIER && ast->tokens[i + 1].type == Token::SEPARATOR && ast->tokens[i + 1].sep == OPEN_PAREN)
+                calls.push_back(ast->tokens[i].iden);
+
+        return;
+    }
+
+    std::vector<ExpressionHandle> stack;
+    for(const auto& arm : func.map)
+    {
+        stack.push_back(arm.first);
+        stack.push_back(arm.second);
+    }
+
+    while(!stack.empty())
+    {
+        Expression& exp = ast->get_exp(stack.back());
+        stack.pop_back();
+
+        if(exp.type == Expression::FUNCTION)
+            calls.push_back(exp.func.name);
+        for_each_child(exp, [&](ExpressionHandle& child) { stack.push_back(child); });
+    }
+}
+
+//loads fileName and its imports through cache, and links them into a new program
+static AST* link_program(ModuleCache& cache, const std::string& fileName, const LoadOptions& options)
+{
+    namespace fs = std::filesystem;
+
+    //load the program and its imports, breadth first:
+    //----------------
+    std::vector<std::pair<std::string, AST*>> modules;
+    std::unordered_set<std::string> seen;
+
+    std::string rootPath = fs::weakly_canonical(fs::path(fileName)).string();
+    AST* root = load_module(cache, rootPath, options, options.lazy);
+    if(root == nullptr)
+        throw new LoadErrorProgramNotFound(fileName);
+
+    //the program's own bodies are all parsed, so every syntax error in it is reported,
+    //even if it was cached as an import. imports are only parsed as far as main reaches
+    if(!options.lazy)
+        parse_bodies(root, {});
+
+    modules.push_back({rootPath, root});
+    seen.insert(rootPath);
+
+    for(size_t i = 0; i < modules.size(); i++)
+    {
+        fs::path dir = fs::path(modules[i].first).parent_path();
+        for(const Import& import : modules[i].second->imports)
+        {
+            std::string path = fs::weakly_canonical(dir / (import.name + ".opal")).string();
+            if(!seen.insert(path).second)
+                continue;
+
+            AST* module = load_module(cache, path, options, true);
+            if(module == nullptr)
+                throw new LoadErrorModuleNotFound(import.name, modules[i].first, import.line, import.charIdx);
+
+            modules.push_back({path, module});
+        }
+    }
+
+    //link every definition by name:
+    //----------------
+    std::unordered_map<std::string, std::pair<AST*, Function*>> definitions;
+    for(auto& module : modules)
+        for(Function& func : module.second->functions)
+            if(!definitions.emplace(func.name, std::make_pair(module.second, &func)).second)
+                throw new LoadErrorFunctionRedef(func.name, module.first, func.nameLine, func.nameCharIdx);
+
+    //find what main can reach:
+    //----------------
+    std::unordered_set<const Function*> reachable;
+    if(options.prune && definitions.count("main"))
+    {
+        std::vector<std::string> calls = {"main"};
+        while(!calls.empty())
+        {
+            auto it = definitions.find(calls.back());
+            calls.pop_back();
+
+            //unknown functions are reported when called
+            if(it == definitions.end() || !reachable.insert(it->second.second).second)
+                continue;
+
+            collect_calls(it->second.first, *it->second.second, calls);
+        }
+    }
+
+    if(!options.lazy)
+        for(auto& module : modules)
+            parse_bodies(module.second, reachable);
+
+    //copy the reachable functions into the program, in load order:
+    //----------------
+    AST* program = new AST;
+    program->passes = options.passes;
+    for(auto& module : modules)
+        program->sourceHash = stable_hash(&module.second->sourceHash, sizeof(uint64_t), program->sourceHash);
+    for(auto& module : modules)
+        for(Function& func : module.second->functions)
+            if(reachable.empty() || reachable.count(&func))
+                program->copy_function(*module.second, func);
+
+    optimize_program(program);
+    return program;
+}
+
+static void free_modules(ModuleCache& cache)
+{
+    for(auto& module : cache)
+        free_ast(module.second);
+    cache.clear();
+}
+
+AST* load_program(const std::string& fileName, const LoadOptions& options)
+{
+    OPAL_STAT_TIME(STAGE_LOAD);
+    std::lock_guard<std::mutex> lock(moduleMutex);
+    if(options.cacheModules)
+        return link_program(moduleCache, fileName, options);
+
+    //modules no other load can see are freed along with this one
+    ModuleCache modules;
+    try
+    {
+        AST* program = link_program(modules, fileName, options);
+        free_modules(modules);
+        return program;
+    }
+    catch(...)
+    {
+        free_modules(modules);
+        throw;
+    }
+}
+
+//murmur3's finalizer mixes in every 8 bytes, chained through the hash so far
+static uint64_t mix_word(uint64_t hash, uint64_t word)
+{
+    hash ^= word;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+uint64_t stable_hash(const void* data, size_t length, uint64_t seed)
+{
+    const char* bytes = (const char*)data;
+    uint64_t hash = mix_word(seed, length * 0x9e3779b97f4a7c15ull);
+
+    size_t i = 0;
+    for(; i + 8 <= length; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash = mix_word(hash, word);
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, length - i);
+    return mix_word(hash, tail ^ ((uint64_t)(length - i) << 56));
+}
+
+void clear_module_cache()
+{
+    std::lock_guard<std::mutex> lock(moduleMutex);
+    free_modules(moduleCache);
+}
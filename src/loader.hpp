@@ -0,0 +1,47 @@
+#ifndef OPAL_LOADER_H
+#define OPAL_LOADER_H
+
+#include "ast.hpp"
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//a byte range of source holding (at most) one top-level function definition
+struct SourceChunk
+{
+    size_t begin;
+    size_t end;
+    int32_t line;
+};
+
+//splits source at every top-level "fn " without lexing it. text before the first
+//function gets its own chunk so stray tokens are still reported by the parser
+std::vector<SourceChunk> scan_functions(const char* source, size_t length);
+
+struct LoadOptions
+{
+    uint32_t numThreads = 0;  //0 picks the hardware concurrency
+    bool lazy = false;        //only parse function bodies once they're first called
+    bool prune = true;        //drop functions main can't reach when linking a program
+    bool cacheModules = true; //keep the modules of a program parsed for later loads
+    PassOptions passes;
+};
+
+//lexes and parses the functions of source in parallel, each task into its own AST
+//that is merged in source order
+AST* load_source(const char* source, size_t length, const LoadOptions& options);
+AST* load_file(const std::string& fileName, const LoadOptions& options);
+
+//loads fileName and every module it imports, then links their functions into a new
+//program, hashing their sources into its sourceHash. imports are lexed up front, but
+//only the bodies main can reach are parsed. with LoadOptions::cacheModules,
+//modules are parsed at most once per process and stay cached until cleared, even if
+//their files change. otherwise they're freed once linked
+AST* load_program(const std::string& fileName, const LoadOptions& options);
+void clear_module_cache();
+
+//hash of length bytes of data that, unlike std::hash, is the same in every process and
+//build on a machine, so it can name data kept across runs
+uint64_t stable_hash(const void* data, size_t length, uint64_t seed = 0);
+
+#endif
@@ -1,44 +1,262 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <vector>
 #include <iostream>
 #include <exception>
+#include <sstream>
 
-#include "lexer.hpp"
+#include "loader.hpp"
 #include "parser.hpp"
 #include "interpreter.hpp"
+#include "stats.hpp"
+#include "memory.hpp"
+#include "output.hpp"
+#include "closure.hpp"
+#include "profile.hpp"
+#include "explain.hpp"
+#include "result_cache.hpp"
 
-#define VERSION 0.1
+#define VERSION "0.1"
+
+//reads the next line of file into line, without its newline. false once file runs out
+static bool read_line(FILE* file, std::string& line)
+{
+	line.clear();
+	char chunk[4096];
+	while(fgets(chunk, sizeof(chunk), file) != nullptr)
+	{
+		const size_t length = strlen(chunk);
+		if(length > 0 && chunk[length - 1] == '\n')
+		{
+			line.append(chunk, length - 1);
+			return true;
+		}
+		line.append(chunk, length);
+	}
+
+	return !line.empty();
+}
 
 int main(int argc, char *argv[])
 {
-	if (argc == 2 && argv[1] == "--version")
+	//options come before the program name:
+	//----------------
+	LoadOptions options;
+	EvalLimits limits;
+	bool check = false;
+	bool explain = false;
+	bool stats = false;
+	bool memReport = false;
+	bool batch = false;
+	bool closureTier = false;
+	const char* recordProfile = nullptr;
+	const char* resultCachePath = nullptr;
+	OutputFormat format = OUTPUT_TEXT;
+
+	int argi = 1;
+	for(; argi < argc && strncmp(argv[argi], "--", 2) == 0; argi++)
 	{
-		printf("%s", VERSION);
-		return 0;
+		if(strcmp(argv[argi], "--version") == 0)
+		{
+			printf("%s\n", VERSION);
+			return 0;
+		}
+		else if(strcmp(argv[argi], "--jobs") == 0 && argi + 1 < argc)
+			options.numThreads = (uint32_t)atoi(argv[++argi]);
+		else if(strcmp(argv[argi], "--lazy") == 0)
+			options.lazy = true;
+		else if(strcmp(argv[argi], "--no-cse") == 0)
+			options.passes.cse = false;
+		else if(strcmp(argv[argi], "--clone-budget") == 0 && argi + 1 < argc)
+			options.passes.cloneBudget = atoi(argv[++argi]);
+		else if(strcmp(argv[argi], "--hot-threshold") == 0 && argi + 1 < argc)
+			options.passes.hotThreshold = atoi(argv[++argi]);
+		else if(strcmp(argv[argi], "--pgo-record") == 0 && argi + 1 < argc)
+			recordProfile = argv[++argi];
+		else if(strcmp(argv[argi], "--pgo-use") == 0 && argi + 1 < argc)
+		{
+			auto profile = std::make_shared<ArmProfile>();
+			if(!read_arm_profile(argv[++argi], *profile))
+			{
+				printf("could not read profile \"%s\"\n", argv[argi]);
+				return -1;
+			}
+			options.passes.armProfile = profile;
+		}
+		else if(strcmp(argv[argi], "--result-cache") == 0 && argi + 1 < argc)
+			resultCachePath = argv[++argi];
+		else if(strcmp(argv[argi], "--fuel") == 0 && argi + 1 < argc)
+			limits.fuel = atoll(argv[++argi]);
+		else if(strcmp(argv[argi], "--timeout") == 0 && argi + 1 < argc)
+			limits.timeout = std::chrono::milliseconds(atoll(argv[++argi]));
+		else if(strcmp(argv[argi], "--check") == 0)
+			check = true;
+		else if(strcmp(argv[argi], "--explain") == 0)
+			explain = true;
+		else if(strcmp(argv[argi], "--stats") == 0)
+			stats = true;
+		else if(strcmp(argv[argi], "--mem-report") == 0)
+			memReport = true;
+		else if(strcmp(argv[argi], "--batch") == 0)
+			batch = true;
+		else if(strcmp(argv[argi], "--tier") == 0 && argi + 1 < argc)
+		{
+			argi++;
+			if(strcmp(argv[argi], "ast") == 0)
+				closureTier = false;
+			else if(strcmp(argv[argi], "closure") == 0)
+				closureTier = true;
+			else
+			{
+				printf("unknown tier \"%s\"\n", argv[argi]);
+				return -1;
+			}
+		}
+		else if(strcmp(argv[argi], "--format") == 0 && argi + 1 < argc)
+		{
+			argi++;
+			if(strcmp(argv[argi], "text") == 0)
+				format = OUTPUT_TEXT;
+			else if(strcmp(argv[argi], "tsv") == 0)
+				format = OUTPUT_TSV;
+			else if(strcmp(argv[argi], "bin") == 0)
+				format = OUTPUT_BINARY;
+			else
+			{
+				printf("unknown format \"%s\"\n", argv[argi]);
+				return -1;
+			}
+		}
+		else
+		{
+			printf("unknown option \"%s\"\n", argv[argi]);
+			return -1;
+		}
 	}
 
-	if(argc < 2)
+	if(argi >= argc)
 		return -1;
 
-	std::string fileName(argv[1]);
+	std::string fileName(argv[argi]);
 	fileName += ".opal";
 	std::vector<std::string> args;
-	for(int i = 2; i < argc; i++)
+	for(int i = argi + 1; i < argc; i++)
 		args.push_back(std::string(argv[i]));
 
+	//checking parses every body up front so all syntax errors are reported, and
+	//explaining so every function can be shown
+	if(check || explain)
+		options.lazy = false;
+
+	//arms are counted by the tree walker, against the arms of the source: functions
+	//aren't cloned, re-optimized or reordered while recording
+	if(recordProfile != nullptr)
+	{
+		if(closureTier)
+		{
+			printf("--pgo-record needs the ast tier\n");
+			return -1;
+		}
+		options.passes.countArms = true;
+		options.passes.cloneBudget = 0;
+		options.passes.hotThreshold = 0;
+		options.passes.armProfile = nullptr;
+	}
+
+	//cached results are only useful to runs that evaluate main, and would hide arms
+	//from a recording
+	ResultCache* resultCache = nullptr;
+	if(resultCachePath != nullptr && !check && !explain)
+	{
+		if(recordProfile != nullptr)
+		{
+			printf("--pgo-record can't use a result cache\n");
+			return -1;
+		}
+
+		resultCache = open_result_cache(resultCachePath);
+		if(resultCache == nullptr)
+		{
+			printf("could not open result cache \"%s\"\n", resultCachePath);
+			return -1;
+		}
+	}
+
+	//the program is freed even when loading or running it throws
+	AST* ast = nullptr;
+	ClosureProgram* closures = nullptr;
+	bool failed = false;
 	try
 	{
-		std::vector<Token> tokens = lex_file(fileName);
-		AST* ast = generate_ast(tokens);
-		std::cout << run(ast, args) << std::endl;
+		ast = load_program(fileName, options);
+		clear_module_cache();
+		mem_snapshot("load");
 
-		free_ast(ast);
-		free_tokens(tokens);
+		closures = closureTier ? compile_closures(ast) : nullptr;
+		mem_snapshot("compile");
+
+		if(explain)
+			fputs(explain_program(ast).c_str(), stdout);
+		else if(!check)
+		{
+			OutputWriter out(stdout, format);
+			if(!batch)
+				out.write_result(args, run_main(ast, args, closures, limits, resultCache));
+			else
+			{
+				//every line of stdin holds the arguments of one evaluation. a line that fails
+				//gets its error in place of its result, and the rest still run
+				std::string line;
+				while(read_line(stdin, line))
+				{
+					std::istringstream lineArgs(line);
+					args.clear();
+					for(std::string arg; lineArgs >> arg;)
+						args.push_back(arg);
+
+					try
+					{
+						out.write_result(args, run_main(ast, args, closures, limits, resultCache));
+					}
+					catch(RuntimeError* e)
+					{
+						out.write_error(args, e->what());
+						delete e;
+					}
+				}
+			}
+		}
+
+		mem_snapshot("run");
+
+		if(recordProfile != nullptr && !check && !explain && !write_arm_profile(recordProfile, ast))
+			printf("could not write profile \"%s\"\n", recordProfile);
 	}
 	catch(std::exception *e)
 	{
-		std::cout << e->what() << std::endl;
+		printf("%s\n", e->what());
+		delete e;
+		clear_module_cache();
+		failed = true;
 	}
 
+	if(resultCache != nullptr)
+		close_result_cache(resultCache);
+	if(closures != nullptr)
+		free_closures(closures);
+	if(ast != nullptr)
+		free_ast(ast);
+	mem_snapshot("free");
+
+	if(failed && check)
+		return 1;
+
+	//stats go to stderr so they can be collected without touching the results
+	if(stats)
+		std::cerr << stats_json() << std::endl;
+	if(memReport)
+		std::cerr << mem_report_json() << std::endl;
+
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,81 @@
+#include "memory.hpp"
+#include <mutex>
+#include <vector>
+
+MemCounters memCounters[NUM_MEM_CATEGORIES + 1] = {};
+
+struct MemSnapshot
+{
+    std::string stage;
+    int64_t liveBytes[NUM_MEM_CATEGORIES + 1];
+    int64_t liveCount[NUM_MEM_CATEGORIES + 1];
+    int64_t peakBytes[NUM_MEM_CATEGORIES + 1];
+};
+
+static std::mutex snapshotMutex;
+static std::vector<MemSnapshot> snapshots;
+
+static const char* CATEGORY_NAMES[NUM_MEM_CATEGORIES + 1] = {
+    "tokens",
+    "identifiers",
+    "expressions",
+    "call_params",
+    "frames",
+    "arrays",
+    "total"
+};
+
+void mem_snapshot(const char* stage)
+{
+    if(!OPAL_MEM_TRACKING)
+        return;
+
+    MemSnapshot snapshot;
+    snapshot.stage = stage;
+    for(int32_t i = 0; i <= NUM_MEM_CATEGORIES; i++)
+    {
+        snapshot.liveBytes[i] = memCounters[i].liveBytes;
+        snapshot.liveCount[i] = memCounters[i].liveCount;
+        snapshot.peakBytes[i] = memCounters[i].peakBytes.exchange(snapshot.liveBytes[i]);
+    }
+
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    snapshots.push_back(snapshot);
+}
+
+std::string mem_report_json()
+{
+    if(!OPAL_MEM_TRACKING)
+        return "{\"enabled\":false}";
+
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+
+    std::string json = "{\"enabled\":true,\"stages\":[";
+    for(size_t s = 0; s < snapshots.size(); s++)
+    {
+        const MemSnapshot& snapshot = snapshots[s];
+        if(s > 0)
+            json += ",";
+
+        json += "{\"stage\":\"" + snapshot.stage + "\"";
+        for(int32_t i = 0; i <= NUM_MEM_CATEGORIES; i++)
+        {
+            json += ",\"" + std::string(CATEGORY_NAMES[i]) + "\":{\"live_bytes\":" + std::to_string(snapshot.liveBytes[i]);
+            json += ",\"live_allocations\":" + std::to_string(snapshot.liveCount[i]);
+            json += ",\"peak_bytes\":" + std::to_string(snapshot.peakBytes[i]) + "}";
+        }
+        json += "}";
+    }
+
+    json += "],\"allocated\":{";
+    for(int32_t i = 0; i <= NUM_MEM_CATEGORIES; i++)
+    {
+        if(i > 0)
+            json += ",";
+        json += "\"" + std::string(CATEGORY_NAMES[i]) + "\":{\"bytes\":" + std::to_string(memCounters[i].totalBytes);
+        json += ",\"allocations\":" + std::to_string(memCounters[i].totalCount) + "}";
+    }
+
+    json += "}}";
+    return json;
+}
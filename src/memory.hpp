@@ -0,0 +1,150 @@
+#ifndef OPAL_MEMORY_H
+#define OPAL_MEMORY_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string.h>
+#include <stdint.h>
+
+//set by the build; without it nothing is counted and the report is empty
+#ifndef OPAL_MEM_TRACKING
+#define OPAL_MEM_TRACKING 0
+#endif
+
+//------------------------------------------------------
+//allocation accounting:
+//
+//heap memory owned by the lexer, parser and interpreter is counted by category, live
+//and peak, in counters shared by every thread. allocations go through the helpers
+//below, or TrackedAllocator for containers, so that every byte counted in is counted
+//back out when it's freed
+
+enum MemCategory
+{
+    MEM_TOKENS,
+    MEM_IDENTIFIERS,
+    MEM_EXPRESSIONS,
+    MEM_CALL_PARAMS,
+    MEM_FRAMES,
+    MEM_ARRAYS,
+
+    NUM_MEM_CATEGORIES
+};
+
+struct MemCounters
+{
+    std::atomic<int64_t> liveBytes;
+    std::atomic<int64_t> liveCount;
+    std::atomic<int64_t> peakBytes; //since the last snapshot
+    std::atomic<uint64_t> totalBytes;
+    std::atomic<uint64_t> totalCount;
+};
+
+extern MemCounters memCounters[NUM_MEM_CATEGORIES + 1]; //the last one sums the others
+
+inline void mem_track_alloc(MemCategory category, size_t bytes)
+{
+#if OPAL_MEM_TRACKING
+    for(MemCounters* counters : {&memCounters[category], &memCounters[NUM_MEM_CATEGORIES]})
+    {
+        int64_t live = counters->liveBytes.fetch_add((int64_t)bytes, std::memory_order_relaxed) + (int64_t)bytes;
+        counters->liveCount.fetch_add(1, std::memory_order_relaxed);
+        counters->totalBytes.fetch_add(bytes, std::memory_order_relaxed);
+        counters->totalCount.fetch_add(1, std::memory_order_relaxed);
+
+        int64_t peak = counters->peakBytes.load(std::memory_order_relaxed);
+        while(live > peak && !counters->peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+    }
+#else
+    (void)category;
+    (void)bytes;
+#endif
+}
+
+inline void mem_track_free(MemCategory category, size_t bytes)
+{
+#if OPAL_MEM_TRACKING
+    for(MemCounters* counters : {&memCounters[category], &memCounters[NUM_MEM_CATEGORIES]})
+    {
+        counters->liveBytes.fetch_sub((int64_t)bytes, std::memory_order_relaxed);
+        counters->liveCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+#else
+    (void)category;
+    (void)bytes;
+#endif
+}
+
+template<typename T>
+T* mem_new_array(MemCategory category, size_t count)
+{
+    mem_track_alloc(category, count * sizeof(T));
+    return new T[count];
+}
+
+//count must be the one the array was made with
+template<typename T>
+void mem_delete_array(MemCategory category, T* array, size_t count)
+{
+    if(array == nullptr)
+        return;
+
+    mem_track_free(category, count * sizeof(T));
+    delete[] array;
+}
+
+inline char* copy_identifier(const char* iden)
+{
+    const size_t length = strlen(iden) + 1;
+    char* copy = mem_new_array<char>(MEM_IDENTIFIERS, length);
+    memcpy(copy, iden, length);
+    return copy;
+}
+
+inline void free_identifier(char* iden)
+{
+    if(iden != nullptr)
+        mem_delete_array(MEM_IDENTIFIERS, iden, strlen(iden) + 1);
+}
+
+//a std::allocator that counts what it holds under CATEGORY
+template<typename T, MemCategory CATEGORY>
+struct TrackedAllocator
+{
+    typedef T value_type;
+
+    template<typename U>
+    struct rebind
+    {
+        typedef TrackedAllocator<U, CATEGORY> other;
+    };
+
+    TrackedAllocator() = default;
+    template<typename U>
+    TrackedAllocator(const TrackedAllocator<U, CATEGORY>&) {}
+
+    T* allocate(size_t n)
+    {
+        mem_track_alloc(CATEGORY, n * sizeof(T));
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        mem_track_free(CATEGORY, n * sizeof(T));
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template<typename U>
+    bool operator==(const TrackedAllocator<U, CATEGORY>&) const { return true; }
+    template<typename U>
+    bool operator!=(const TrackedAllocator<U, CATEGORY>&) const { return false; }
+};
+
+//records what's live in every category and the peak since the previous snapshot,
+//which is then reset, so each stage gets its own peak
+void mem_snapshot(const char* stage);
+std::string mem_report_json();
+
+#endif
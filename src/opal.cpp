@@ -0,0 +1,113 @@
+#include "opal.hpp"
+#include "closure.hpp"
+#include "interpreter.hpp"
+#include "parser.hpp"
+#include "stats.hpp"
+#include "value.hpp"
+#include <vector>
+
+//------------------------------------------------------
+//helper func definitions:
+
+static Value to_value(const OpalValue& value)
+{
+    switch(value.type)
+    {
+    case OpalValue::FLOAT:
+        return Value(value.f);
+    case OpalValue::BOOL:
+        return Value(value.b);
+    default:
+        return Value(value.i);
+    }
+}
+
+static OpalValue from_value(Value value)
+{
+    if(value.is_float())
+        return OpalValue(value.as_float());
+    if(value.is_bool())
+        return OpalValue(value.as_bool());
+    return OpalValue(value.as_int());
+}
+
+//------------------------------------------------------
+//non-static func definitions:
+
+OpalProgram* opal_load(const std::string& fileName, const LoadOptions& options)
+{
+    //a program is loaded from its files as they are now, and owns everything it uses
+    LoadOptions programOptions = options;
+    programOptions.prune = false;
+    programOptions.cacheModules = false;
+
+    AST* ast = load_program(fileName + ".opal", programOptions);
+    ClosureProgram* closures;
+    try
+    {
+        closures = compile_closures(ast, true);
+    }
+    catch(std::exception* e)
+    {
+        free_ast(ast);
+        throw;
+    }
+
+    return new OpalProgram{ast, closures};
+}
+
+void opal_free(OpalProgram* program)
+{
+    free_closures(program->closures);
+    free_ast(program->ast);
+    delete program;
+}
+
+bool opal_find(OpalProgram* program, const std::string& name, OpalFunction& function)
+{
+    function.compiled = find_compiled(program->closures, name);
+    if(function.compiled == nullptr)
+        return false;
+
+    function.numParams = (int32_t)function.compiled->source->params.size();
+    return true;
+}
+
+OpalValue opal_call(const OpalFunction& function, const OpalValue* args, int32_t numArgs, const EvalLimits& limits)
+{
+    OPAL_EVAL_STAT_SCOPE();
+    EvalBudgetScope budget(limits);
+
+    //boxes made by the call, and for its args, are released once its result is read,
+    //even if it throws
+    const BoxMark boxMark = mark_boxes();
+
+    Value stackArgs[MAX_STACK_ARGS];
+    ValueFrames heapArgs;
+
+    Value* values = stackArgs;
+    if(numArgs > MAX_STACK_ARGS)
+    {
+        heapArgs.resize(numArgs);
+        values = heapArgs.data();
+    }
+
+    for(int32_t i = 0; i < numArgs; i++)
+        values[i] = to_value(args[i]);
+
+    try
+    {
+        Value value = call_closure(function.compiled, values, numArgs);
+        if(value.is_array())
+            throw new RuntimeErrorArrayResult(function.compiled->source->name, function.compiled->source->line, 0);
+
+        OpalValue result = from_value(value);
+        release_boxes(boxMark, Value(false));
+        return result;
+    }
+    catch(std::exception* e)
+    {
+        release_boxes(boxMark, Value(false));
+        throw;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef OPAL_API_H
+#define OPAL_API_H
+
+#include "loader.hpp"
+#include "budget.hpp"
+#include <string>
+#include <stdint.h>
+
+//------------------------------------------------------
+//embedding api:
+//
+//a program is loaded once, fully parsed and compiled to closures, and never changes
+//afterwards. any number of threads may then look up functions and call them at once.
+//loading and freeing must not overlap with calls into the same program.
+//
+//errors are thrown like everywhere else in opal, as heap allocated std::exception
+//pointers (LoadError, ParseError or RuntimeError) owned by the catcher
+
+struct AST;
+struct ClosureProgram;
+struct CompiledFunction;
+
+struct OpalValue
+{
+    enum Type
+    {
+        INT,
+        FLOAT,
+        BOOL
+    } type;
+
+    union
+    {
+        int64_t i;
+        double f;
+        bool b;
+    };
+
+    constexpr OpalValue()          : type(INT), i(0) {}
+    constexpr OpalValue(int64_t v) : type(INT), i(v) {}
+    constexpr OpalValue(double v)  : type(FLOAT), f(v) {}
+    constexpr OpalValue(bool v)    : type(BOOL), b(v) {}
+};
+
+struct OpalProgram
+{
+    AST* ast;
+    ClosureProgram* closures;
+};
+
+//a prepared call target, valid as long as its program
+struct OpalFunction
+{
+    CompiledFunction* compiled;
+    int32_t numParams;
+};
+
+//loads fileName (with its ".opal" extension) and everything it imports, reading them
+//again on every load. functions aren't pruned, since any of them can be looked up.
+//throws a LoadError if fileName doesn't exist
+OpalProgram* opal_load(const std::string& fileName, const LoadOptions& options = LoadOptions());
+void opal_free(OpalProgram* program);
+
+//returns false if program has no function called name
+bool opal_find(OpalProgram* program, const std::string& name, OpalFunction& function);
+
+//calls function with numArgs args, within limits. doesn't allocate when the params and
+//cse temps of every function called fit in MAX_STACK_ARGS (closure.hpp). arrays can be
+//used inside the call, but throw RuntimeErrorArrayResult if returned
+OpalValue opal_call(const OpalFunction& function, const OpalValue* args, int32_t numArgs, const EvalLimits& limits = EvalLimits());
+
+#endif
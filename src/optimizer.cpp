@@ -0,0 +1,902 @@
+#include "optimizer.hpp"
+#include "output.hpp"
+#include "value.hpp"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <unordered_map>
+
+//------------------------------------------------------
+//helper func definitions:
+
+//calls visit(handle) for every node under the roots, children before their parents,
+//visiting shared nodes once
+template<typename Visit>
+static void post_order(AST* ast, const std::vector<ExpressionHandle>& roots, Visit visit)
+{
+    std::unordered_map<ExpressionHandle, bool> visited;
+    std::vector<std::pair<ExpressionHandle, bool>> stack;
+    for(auto it = roots.rbegin(); it != roots.rend(); it++)
+        stack.push_back({*it, false});
+
+    while(!stack.empty())
+    {
+        ExpressionHandle handle = stack.back().first;
+        if(visited.count(handle))
+        {
+            stack.pop_back();
+            continue;
+        }
+
+        if(!stack.back().second)
+        {
+            stack.back().second = true;
+            Expression exp = ast->get_exp(handle);
+            for_each_child(exp, [&](ExpressionHandle& child) { stack.push_back({child, false}); });
+            continue;
+        }
+
+        stack.pop_back();
+        visited[handle] = true;
+        visit(handle);
+    }
+}
+
+//how many times each node under the roots occurs in them as trees, a shared node
+//counting once for every path to it. saturates instead of wrapping around
+static std::unordered_map<ExpressionHandle, int32_t> count_occurrences(AST* ast, const std::vector<ExpressionHandle>& roots)
+{
+    std::vector<ExpressionHandle> order;
+    post_order(ast, roots, [&](ExpressionHandle handle) { order.push_back(handle); });
+
+    std::unordered_map<ExpressionHandle, int32_t> occurrences;
+    for(ExpressionHandle root : roots)
+        occurrences[root]++;
+
+    //in reverse post order parents come before their children, so a count is final once it is passed down
+    for(auto it = order.rbegin(); it != order.rend(); it++)
+    {
+        const int32_t count = occurrences[*it];
+        Expression exp = ast->get_exp(*it);
+        for_each_child(exp, [&](ExpressionHandle& child)
+        {
+            int32_t& childCount = occurrences[child];
+            childCount = count > INT32_MAX - childCount ? INT32_MAX : childCount + count;
+        });
+    }
+    return occurrences;
+}
+
+static std::vector<ExpressionHandle> arm_roots(const Function* func)
+{
+    std::vector<ExpressionHandle> roots;
+    for(const auto& arm : func->map)
+    {
+        roots.push_back(arm.second);
+        roots.push_back(arm.first);
+    }
+    return roots;
+}
+
+//adds a copy of exp that owns its own name and params, like every parsed node
+static ExpressionHandle add_node(AST* ast, Expression exp)
+{
+    if(exp.type == Expression::FUNCTION)
+    {
+        ExpressionHandle* params = mem_new_array<ExpressionHandle>(MEM_CALL_PARAMS, exp.func.numParams);
+        if(exp.func.numParams > 0)
+            memcpy(params, exp.func.params, exp.func.numParams * sizeof(ExpressionHandle));
+        exp.func.params = params;
+        exp.func.name = copy_identifier(exp.func.name);
+    }
+    else if(exp.type == Expression::VARIABLE)
+        exp.var.name = copy_identifier(exp.var.name);
+
+    return ast->add_exp(exp);
+}
+
+//returns the arms of func rebuilt bottom up. rewrite is passed every node once its
+//children are rebuilt, and returns its replacement. nodes are never modified in place,
+//only copied when something under them changes
+template<typename Rewrite>
+static std::vector<Arm> rebuild_arms(AST* ast, const Function* func, Rewrite rewrite)
+{
+    std::vector<Arm> arms = func->map;
+
+    std::unordered_map<ExpressionHandle, ExpressionHandle> rebuilt;
+    post_order(ast, arm_roots(func), [&](ExpressionHandle handle)
+    {
+        Expression exp = ast->get_exp(handle);
+        bool childrenChanged = false;
+        for_each_child(exp, [&](ExpressionHandle& child) { childrenChanged |= rebuilt.at(child) != child; });
+
+        //params arrays are shared with the original, so only the copy's are relinked
+        ExpressionHandle result = handle;
+        if(childrenChanged)
+        {
+            result = add_node(ast, exp);
+            for_each_child(ast->get_exp(result), [&](ExpressionHandle& child) { child = rebuilt.at(child); });
+        }
+
+        rebuilt[handle] = rewrite(result);
+    });
+
+    for(auto& arm : arms)
+    {
+        arm.first = rebuilt.at(arm.first);
+        arm.second = rebuilt.at(arm.second);
+    }
+    return arms;
+}
+
+//------------------------------------------------------
+//common subexpression elimination:
+
+//key identifying the structure of a node, given the value numbers of its children
+static std::string structure_key(const Expression& exp, const std::unordered_map<ExpressionHandle, int32_t>& numbers)
+{
+    std::string key(1, (char)exp.type);
+    auto append = [&](const void* data, size_t size) { key.append((const char*)data, size); };
+
+    switch(exp.type)
+    {
+    case Expression::OPERATOR:
+        append(&exp.op.op, sizeof(exp.op.op));
+        break;
+    case Expression::FUNCTION:
+        key += exp.func.name;
+        key += '\0';
+        break;
+    case Expression::VARIABLE:
+        key += exp.var.name;
+        break;
+    case Expression::INT_LITERAL:
+        append(&exp.intLit.val, sizeof(exp.intLit.val));
+        break;
+    case Expression::FLOAT_LITERAL:
+        append(&exp.floatLit.val, sizeof(exp.floatLit.val));
+        break;
+    case Expression::TEMP:
+        append(&exp.temp.slot, sizeof(exp.temp.slot));
+        break;
+    }
+
+    Expression copy = exp;
+    for_each_child(copy, [&](ExpressionHandle& child) { append(&numbers.at(child), sizeof(int32_t)); });
+    return key;
+}
+
+void eliminate_common_subexpressions(AST* ast, Function* func)
+{
+    std::vector<ExpressionHandle> roots = arm_roots(func);
+
+    //number every node so structurally equal subtrees get the same number:
+    //----------------
+    std::unordered_map<std::string, int32_t> keys;
+    std::unordered_map<ExpressionHandle, int32_t> numbers;
+    post_order(ast, roots, [&](ExpressionHandle handle)
+    {
+        auto it = keys.emplace(structure_key(ast->get_exp(handle), numbers), (int32_t)keys.size()).first;
+        numbers[handle] = it->second;
+    });
+
+    //count occurrences, top down. the inside of a repeated subtree only counts once,
+    //since every repetition will share the first one's temporary:
+    //----------------
+    std::vector<int32_t> counts(keys.size(), 0);
+    std::vector<ExpressionHandle> stack(roots.begin(), roots.end());
+    bool repeated = false;
+    while(!stack.empty())
+    {
+        ExpressionHandle handle = stack.back();
+        stack.pop_back();
+
+        if(counts[numbers[handle]]++ > 0)
+        {
+            repeated = true;
+            continue;
+        }
+
+        Expression exp = ast->get_exp(handle);
+        for_each_child(exp, [&](ExpressionHandle& child) { stack.push_back(child); });
+    }
+
+    if(!repeated)
+        return;
+
+    //rebuild the arms, replacing repeated calls and operations with temporaries:
+    //----------------
+    std::unordered_map<int32_t, ExpressionHandle> rebuilt;
+    post_order(ast, roots, [&](ExpressionHandle handle)
+    {
+        int32_t number = numbers[handle];
+        if(rebuilt.count(number))
+            return;
+
+        Expression exp = ast->get_exp(handle);
+        bool childrenChanged = false;
+        for_each_child(exp, [&](ExpressionHandle& child)
+        {
+            ExpressionHandle newChild = rebuilt.at(numbers.at(child));
+            childrenChanged |= newChild != child;
+        });
+
+        ExpressionHandle result = handle;
+        if(childrenChanged)
+        {
+            result = add_node(ast, exp);
+            for_each_child(ast->get_exp(result), [&](ExpressionHandle& child) { child = rebuilt.at(numbers.at(child)); });
+        }
+
+        bool hoistable = exp.type == Expression::FUNCTION || (exp.type == Expression::OPERATOR && exp.op.op != OTHERWISE);
+        if(hoistable && counts[number] > 1)
+        {
+            Expression temp(exp.line, exp.charIdx);
+            temp.type = Expression::TEMP;
+            temp.temp.slot = (int32_t)func->params.size() + func->numTemps++;
+            temp.temp.exp = result;
+            result = ast->add_exp(temp);
+        }
+
+        rebuilt[number] = result;
+    });
+
+    for(auto& arm : func->map)
+    {
+        arm.first = rebuilt.at(numbers.at(arm.first));
+        arm.second = rebuilt.at(numbers.at(arm.second));
+    }
+}
+
+//------------------------------------------------------
+//constant argument specialization:
+
+static bool is_literal(const Expression& exp)
+{
+    return exp.type == Expression::INT_LITERAL || exp.type == Expression::FLOAT_LITERAL;
+}
+
+static Value literal_value(const Expression& exp)
+{
+    if(exp.type == Expression::INT_LITERAL)
+        return Value((int64_t)exp.intLit.val);
+    return Value(exp.floatLit.val);
+}
+
+//evaluates op on two constants the way both tiers would. false if it can't be folded,
+//because op isn't arithmetic or a comparison or it would fail at runtime
+static bool fold_operator(Operator op, Value l, Value r, Value& result)
+{
+    if((op == DIV || op == MOD) && !l.is_float() && !r.is_float() && r.get_int() == 0)
+        return false;
+
+    switch(op)
+    {
+    case ADD:       result = l + r; return true;
+    case SUB:       result = l - r; return true;
+    case MULT:      result = l * r; return true;
+    case DIV:       result = l / r; return true;
+    case MOD:       result = l % r; return true;
+    case EXP:       result = l.to(r); return true;
+    case EQUALITY:  result = l == r; return true;
+    case LESS:      result = l < r; return true;
+    case GREATER:   result = l > r; return true;
+    case LESSEQ:    result = l <= r; return true;
+    case GREATEREQ: result = l >= r; return true;
+    default:        return false;
+    }
+}
+
+//folds an operator node on two literals into a literal, if its result is one
+static ExpressionHandle fold_literals(AST* ast, ExpressionHandle handle)
+{
+    Expression exp = ast->get_exp(handle);
+    if(exp.type != Expression::OPERATOR || exp.op.op == OTHERWISE)
+        return handle;
+
+    const Expression& left = ast->get_exp(exp.op.left);
+    const Expression& right = ast->get_exp(exp.op.right);
+    if(!is_literal(left) || !is_literal(right))
+        return handle;
+
+    const BoxMark boxMark = mark_boxes();
+    Value result;
+    bool folded = fold_operator(exp.op.op, literal_value(left), literal_value(right), result);
+    release_boxes(boxMark, Value(false));
+    if(!folded)
+        return handle;
+
+    Expression literal(exp.line, exp.charIdx);
+    if(result.is_float())
+    {
+        literal.type = Expression::FLOAT_LITERAL;
+        literal.floatLit.val = result.as_float();
+    }
+    else if(result.is_int() && !result.is_boxed() && result.as_int() >= INT32_MIN && result.as_int() <= INT32_MAX)
+    {
+        literal.type = Expression::INT_LITERAL;
+        literal.intLit.val = (int32_t)result.as_int();
+    }
+    else
+        return handle;
+
+    return ast->add_exp(literal);
+}
+
+//1 if guard always holds, 0 if it never does, -1 if that depends on the call
+static int guard_truth(AST* ast, ExpressionHandle guard)
+{
+    const Expression& exp = ast->get_exp(guard);
+    if(exp.type != Expression::OPERATOR)
+        return -1;
+    if(exp.op.op == OTHERWISE)
+        return 1;
+
+    const Expression& left = ast->get_exp(exp.op.left);
+    const Expression& right = ast->get_exp(exp.op.right);
+    if(!is_literal(left) || !is_literal(right))
+        return -1;
+
+    Value result;
+    if(!fold_operator(exp.op.op, literal_value(left), literal_value(right), result) || !result.is_bool())
+        return -1;
+    return result.as_bool() ? 1 : 0;
+}
+
+//arms without those whose guards never hold, or that follow one that always does
+static std::vector<Arm> drop_dead_arms(AST* ast, const std::vector<Arm>& arms)
+{
+    std::vector<Arm> live;
+    for(const auto& arm : arms)
+    {
+        int truth = guard_truth(ast, arm.second);
+        if(truth == 0)
+            continue;
+
+        if(truth == 1)
+        {
+            Expression otherwise(ast->get_exp(arm.second).line, ast->get_exp(arm.second).charIdx);
+            otherwise.type = Expression::OPERATOR;
+            otherwise.op.op = OTHERWISE;
+            live.push_back(arm);
+            live.back().second = ast->add_exp(otherwise);
+            break;
+        }
+
+        live.push_back(arm);
+    }
+    return live;
+}
+
+//name of the clone of target for the constant args of call, e.g. "fact[_,1]". "" if
+//the call has no constant args, or doesn't match target
+static std::string clone_name(AST* ast, const Expression& call, const Function* target)
+{
+    if(target == nullptr || !target->parsed || call.func.numParams != (int32_t)target->params.size())
+        return "";
+
+    std::string name = target->name + "[";
+    bool constant = false;
+    for(int32_t i = 0; i < call.func.numParams; i++)
+    {
+        const Expression& arg = ast->get_exp(call.func.params[i]);
+        if(i > 0)
+            name += ",";
+
+        if(is_literal(arg))
+        {
+            char text[MAX_VALUE_CHARS];
+            name.append(text, format_value(literal_value(arg), text));
+            constant = true;
+        }
+        else
+            name += "_";
+    }
+
+    return constant ? name + "]" : "";
+}
+
+//adds a copy of target with the constant args of call substituted for their params,
+//folded, and with the arms they rule out dropped. the clone only takes the other args
+static void add_clone(AST* ast, const std::string& name, const Expression& call, size_t targetIdx)
+{
+    Function clone;
+    clone.name = name;
+    clone.line = ast->functions[targetIdx].line;
+    clone.nameLine = ast->functions[targetIdx].nameLine;
+    clone.nameCharIdx = ast->functions[targetIdx].nameCharIdx;
+    clone.numTemps = ast->functions[targetIdx].numTemps;
+    clone.optimized = true;
+
+    //each param either gets a slot in the clone or is one of the constants
+    std::vector<ExpressionHandle> constants(call.func.numParams);
+    std::vector<int32_t> slots(call.func.numParams, -1);
+    for(int32_t i = 0; i < call.func.numParams; i++)
+    {
+        if(is_literal(ast->get_exp(call.func.params[i])))
+            constants[i] = call.func.params[i];
+        else
+        {
+            slots[i] = (int32_t)clone.params.size();
+            clone.params.push_back(ast->functions[targetIdx].params[i]);
+        }
+    }
+    const int32_t dropped = call.func.numParams - (int32_t)clone.params.size();
+
+    auto arms = rebuild_arms(ast, &ast->functions[targetIdx], [&](ExpressionHandle handle)
+    {
+        Expression exp = ast->get_exp(handle);
+        if(exp.type == Expression::VARIABLE && exp.var.slot >= 0)
+        {
+            if(slots[exp.var.slot] < 0)
+            {
+                Expression literal = ast->get_exp(constants[exp.var.slot]);
+                literal.line = exp.line;
+                literal.charIdx = exp.charIdx;
+                return ast->add_exp(literal);
+            }
+
+            exp.var.slot = slots[exp.var.slot];
+            return add_node(ast, exp);
+        }
+        else if(exp.type == Expression::TEMP)
+        {
+            if(is_literal(ast->get_exp(exp.temp.exp)))
+                return exp.temp.exp;
+
+            exp.temp.slot -= dropped;
+            return ast->add_exp(exp);
+        }
+
+        return fold_literals(ast, handle);
+    });
+
+    clone.map = drop_dead_arms(ast, arms);
+    ast->add_function(std::move(clone));
+}
+
+//how often a call is taken to run, in ranking the constant arg patterns: once per site,
+//times RECURSION_WEIGHT when the caller calls itself, as the site then runs on every
+//level of the recursion, and again when the callee does, as every call into it starts
+//a recursion of its own. a pattern weighing less than CLONE_MIN_WEIGHT, called once from
+//code that runs once, isn't worth a function of the budget
+constexpr int64_t RECURSION_WEIGHT = 8;
+constexpr int64_t CLONE_MIN_WEIGHT = 2;
+
+void specialize_constant_arguments(AST* ast)
+{
+    int32_t budget = ast->passes.cloneBudget;
+
+    //functions that call themselves:
+    //----------------
+    std::vector<bool> recursive(ast->functions.size(), false);
+    for(size_t f = 0; f < ast->functions.size(); f++)
+    {
+        if(!ast->functions[f].parsed)
+            continue;
+
+        post_order(ast, arm_roots(&ast->functions[f]), [&](ExpressionHandle handle)
+        {
+            const Expression& exp = ast->get_exp(handle);
+            if(exp.type == Expression::FUNCTION && exp.func.name == ast->functions[f].name)
+                recursive[f] = true;
+        });
+    }
+
+    //rank the constant arg patterns of the program by how often they're called:
+    //----------------
+    std::unordered_map<std::string, int64_t> counts;
+    std::vector<std::pair<std::string, ExpressionHandle>> patterns;
+    for(size_t f = 0; f < ast->functions.size(); f++)
+    {
+        const Function& func = ast->functions[f];
+        if(!func.parsed)
+            continue;
+
+        //a call cse shared between sites counts once for each of them
+        std::unordered_map<ExpressionHandle, int32_t> occurrences = count_occurrences(ast, arm_roots(&func));
+        post_order(ast, arm_roots(&func), [&](ExpressionHandle handle)
+        {
+            const Expression& exp = ast->get_exp(handle);
+            if(exp.type != Expression::FUNCTION)
+                return;
+
+            const Function* target = ast->find_function(exp.func.name);
+            std::string name = clone_name(ast, exp, target);
+            if(name.empty())
+                return;
+
+            int64_t weight = occurrences.at(handle);
+            if(recursive[f])
+                weight *= RECURSION_WEIGHT;
+            if(recursive[target - ast->functions.data()])
+                weight *= RECURSION_WEIGHT;
+
+            if(counts[name] == 0)
+                patterns.push_back({name, handle});
+            counts[name] = std::min<int64_t>(counts[name] + weight, INT32_MAX);
+        });
+    }
+
+    std::stable_sort(patterns.begin(), patterns.end(), [&](const auto& a, const auto& b) { return counts[a.first] > counts[b.first]; });
+    for(size_t i = 0; i < patterns.size() && budget > 0 && counts[patterns[i].first] >= CLONE_MIN_WEIGHT; i++, budget--)
+    {
+        Expression call = ast->get_exp(patterns[i].second);
+        add_clone(ast, patterns[i].first, call, ast->find_function(call.func.name) - ast->functions.data());
+    }
+
+    //point calls at the clones. constants folded inside a clone may call for clones of
+    //other functions, made while the budget lasts, since the clone already stands for
+    //calls that run often. recursive calls with new constants aren't cloned though, since every
+    //level would get its own copy:
+    //----------------
+    std::unordered_map<std::string, std::string> cloneOf;
+    for(const auto& pattern : patterns)
+        cloneOf[pattern.first] = ast->get_exp(pattern.second).func.name;
+
+    for(size_t f = 0; f < ast->functions.size(); f++)
+    {
+        if(!ast->functions[f].parsed)
+            continue;
+
+        auto it = cloneOf.find(ast->functions[f].name);
+        const bool isClone = it != cloneOf.end();
+        std::string base = isClone ? it->second : ast->functions[f].name;
+
+        Function func = ast->functions[f];
+        auto arms = rebuild_arms(ast, &func, [&](ExpressionHandle handle)
+        {
+            Expression exp = ast->get_exp(handle);
+            if(exp.type != Expression::FUNCTION)
+                return handle;
+
+            Function* target = ast->find_function(exp.func.name);
+            std::string name = clone_name(ast, exp, target);
+            if(name.empty())
+                return handle;
+
+            if(ast->find_function(name) == nullptr)
+            {
+                if(budget <= 0 || !isClone || exp.func.name == base)
+                    return handle;
+
+                budget--;
+                cloneOf[name] = exp.func.name;
+                add_clone(ast, name, exp, target - ast->functions.data());
+            }
+
+            std::vector<ExpressionHandle> args;
+            for(int32_t i = 0; i < exp.func.numParams; i++)
+                if(!is_literal(ast->get_exp(exp.func.params[i])))
+                    args.push_back(exp.func.params[i]);
+
+            Expression call = exp;
+            call.func.name = (char*)name.c_str();
+            call.func.numParams = (int32_t)args.size();
+            call.func.params = args.data();
+            call.func.target = -1;
+            return add_node(ast, call);
+        });
+
+        ast->functions[f].map = arms;
+    }
+}
+
+//------------------------------------------------------
+//arm reordering:
+
+//the values of a param a guard holds for, when it compares the param with a literal.
+//values compare as the doubles they convert to, exactly so while int literals stay
+//below 2^53, and nan fails every comparison, so the range is an interval of reals
+struct GuardRange
+{
+    int32_t slot = -1; //-1 if the guard isn't such a comparison
+    ExpressionHandle var = 0;
+    double low = -INFINITY;
+    double high = INFINITY;
+    bool lowOpen = true;
+    bool highOpen = true;
+    ExpressionHandle lowLiteral = 0;
+    ExpressionHandle highLiteral = 0;
+};
+
+static GuardRange guard_range(AST* ast, ExpressionHandle guard)
+{
+    GuardRange range;
+    const Expression& exp = ast->get_exp(guard);
+    if(exp.type != Expression::OPERATOR || exp.op.op == OTHERWISE)
+        return range;
+
+    Operator op = exp.op.op;
+    ExpressionHandle var = exp.op.left;
+    ExpressionHandle literal = exp.op.right;
+    if(ast->get_exp(var).type != Expression::VARIABLE)
+    {
+        std::swap(var, literal);
+        if(op == LESS || op == GREATER)
+            op = op == LESS ? GREATER : LESS;
+        else if(op == LESSEQ || op == GREATEREQ)
+            op = op == LESSEQ ? GREATEREQ : LESSEQ;
+    }
+
+    const Expression& varExp = ast->get_exp(var);
+    const Expression& litExp = ast->get_exp(literal);
+    if(varExp.type != Expression::VARIABLE || varExp.var.slot < 0 || !is_literal(litExp))
+        return range;
+
+    const double value = litExp.type == Expression::INT_LITERAL ? (double)litExp.intLit.val : litExp.floatLit.val;
+    if(isnan(value))
+        return range;
+
+    switch(op)
+    {
+    case EQUALITY:
+        range.low = range.high = value;
+        range.lowOpen = range.highOpen = false;
+        break;
+    case LESS:
+    case LESSEQ:
+        range.high = value;
+        range.highOpen = op == LESS;
+        break;
+    case GREATER:
+    case GREATEREQ:
+        range.low = value;
+        range.lowOpen = op == GREATER;
+        break;
+    default:
+        return range;
+    }
+
+    range.slot = varExp.var.slot;
+    range.var = var;
+    range.lowLiteral = range.highLiteral = literal;
+    return range;
+}
+
+//true if no value of the param is in both ranges
+static bool disjoint(const GuardRange& a, const GuardRange& b)
+{
+    if(a.slot < 0 || a.slot != b.slot)
+        return false;
+
+    auto below = [](const GuardRange& x, const GuardRange& y)
+    {
+        return x.high < y.low || (x.high == y.low && (x.highOpen || y.lowOpen));
+    };
+    return below(a, b) || below(b, a);
+}
+
+struct ProfiledArm
+{
+    Arm arm;
+    GuardRange range;
+    uint64_t hits;
+};
+
+//adds arm after the others, then moves it ahead of the colder arms before it for as
+//long as swapping them can't change which one holds first
+static void insert_by_hits(std::vector<ProfiledArm>& arms, const ProfiledArm& arm)
+{
+    size_t pos = arms.size();
+    while(pos > 0 && arms[pos - 1].hits < arm.hits && disjoint(arms[pos - 1].range, arm.range))
+        pos--;
+    arms.insert(arms.begin() + pos, arm);
+}
+
+//an arm for the body of the otherwise arm, guarded by the values above (or else below)
+//the run of comparisons on one param that ends arms. it holds only where otherwise would
+//have been reached, so it can pass that run, while otherwise stays as the fallback for
+//everything outside the range
+static bool hoist_otherwise(AST* ast, const std::vector<ProfiledArm>& arms, const ProfiledArm& otherwise, ProfiledArm& hoisted)
+{
+    if(arms.empty() || arms.back().range.slot < 0)
+        return false;
+
+    const int32_t slot = arms.back().range.slot;
+    GuardRange covered = arms.back().range;
+    for(size_t i = arms.size(); i > 0 && arms[i - 1].range.slot == slot; i--)
+    {
+        const GuardRange& range = arms[i - 1].range;
+        if(range.high > covered.high || (range.high == covered.high && !range.highOpen))
+        {
+            covered.high = range.high;
+            covered.highOpen = range.highOpen;
+            covered.highLiteral = range.highLiteral;
+        }
+        if(range.low < covered.low || (range.low == covered.low && !range.lowOpen))
+        {
+            covered.low = range.low;
+            covered.lowOpen = range.lowOpen;
+            covered.lowLiteral = range.lowLiteral;
+        }
+    }
+
+    const Expression& guard = ast->get_exp(otherwise.arm.second);
+    Expression bound(guard.line, guard.charIdx);
+    bound.type = Expression::OPERATOR;
+    bound.op.parenDepth = 0;
+    bound.op.left = covered.var;
+
+    hoisted.range = GuardRange();
+    hoisted.range.slot = slot;
+    hoisted.range.var = covered.var;
+    if(covered.high != INFINITY)
+    {
+        bound.op.op = covered.highOpen ? GREATEREQ : GREATER;
+        bound.op.right = covered.highLiteral;
+        hoisted.range.low = covered.high;
+        hoisted.range.lowOpen = !covered.highOpen;
+    }
+    else if(covered.low != -INFINITY)
+    {
+        bound.op.op = covered.lowOpen ? LESSEQ : LESS;
+        bound.op.right = covered.lowLiteral;
+        hoisted.range.high = covered.low;
+        hoisted.range.highOpen = !covered.lowOpen;
+    }
+    else
+        return false;
+
+    hoisted.arm = otherwise.arm;
+    hoisted.arm.second = ast->add_exp(bound);
+    hoisted.hits = otherwise.hits;
+    return true;
+}
+
+void reorder_arms(AST* ast, Function* func)
+{
+    if(!ast->passes.armProfile)
+        return;
+
+    auto profile = ast->passes.armProfile->find(func->name);
+    if(profile == ast->passes.armProfile->end() || profile->second.size() != func->map.size())
+        return;
+
+    std::vector<ProfiledArm> arms;
+    for(size_t i = 0; i < func->map.size(); i++)
+    {
+        ProfiledArm arm = {func->map[i], guard_range(ast, func->map[i].second), profile->second[i]};
+
+        ProfiledArm hoisted;
+        const Expression& guard = ast->get_exp(arm.arm.second);
+        bool isOtherwise = guard.type == Expression::OPERATOR && guard.op.op == OTHERWISE;
+        if(isOtherwise && i + 1 == func->map.size() && arm.hits > 0 && hoist_otherwise(ast, arms, arm, hoisted))
+        {
+            insert_by_hits(arms, hoisted);
+            arm.hits = 0;
+        }
+
+        insert_by_hits(arms, arm);
+    }
+
+    func->map.clear();
+    for(const ProfiledArm& arm : arms)
+        func->map.push_back(arm.arm);
+}
+
+//------------------------------------------------------
+//hot functions:
+
+//bodies up to this many nodes are inlined
+constexpr size_t HOT_INLINE_MAX_NODES = 24;
+
+//returns call replaced by a copy of its target's body, if the target has one arm that
+//always holds and a small body. args the body uses more than once become temps of the
+//caller, numbered from numTemps, so each is still evaluated at most once and only if
+//needed. returns call itself if it can't be inlined
+static ExpressionHandle inline_call(AST* ast, const Function* caller, int32_t& numTemps, ExpressionHandle call)
+{
+    const Expression exp = ast->get_exp(call);
+    const Function* target = ast->find_function(exp.func.name);
+    if(target == nullptr || target == caller || !target->parsed || exp.func.numParams != (int32_t)target->params.size())
+        return call;
+
+    const auto& arms = target->hot ? target->hotMap : target->map;
+    if(arms.size() != 1 || guard_truth(ast, arms[0].second) != 1)
+        return call;
+
+    //params are counted per occurrence, since cse and interning share the nodes of equal uses
+    size_t size = 0;
+    std::vector<int64_t> uses(target->params.size(), 0);
+    for(const auto& [handle, count] : count_occurrences(ast, {arms[0].first}))
+    {
+        const Expression& node = ast->get_exp(handle);
+        if(node.type == Expression::VARIABLE && node.var.slot >= 0)
+            uses[node.var.slot] += count;
+        size++;
+    }
+    if(size > HOT_INLINE_MAX_NODES)
+        return call;
+
+    const int32_t firstTemp = (int32_t)caller->params.size();
+    std::vector<ExpressionHandle> args(exp.func.params, exp.func.params + exp.func.numParams);
+    for(size_t i = 0; i < args.size(); i++)
+    {
+        const Expression& arg = ast->get_exp(args[i]);
+        if(uses[i] < 2 || is_literal(arg) || arg.type == Expression::VARIABLE || arg.type == Expression::TEMP)
+            continue;
+
+        Expression temp(arg.line, arg.charIdx);
+        temp.type = Expression::TEMP;
+        temp.temp.slot = firstTemp + numTemps++;
+        temp.temp.exp = args[i];
+        args[i] = ast->add_exp(temp);
+    }
+
+    //the target's own temps get fresh slots in the caller's frame
+    std::unordered_map<int32_t, int32_t> tempSlots;
+    std::unordered_map<ExpressionHandle, ExpressionHandle> copied;
+    post_order(ast, {arms[0].first}, [&](ExpressionHandle handle)
+    {
+        Expression node = ast->get_exp(handle);
+        if(node.type == Expression::VARIABLE && node.var.slot >= 0)
+        {
+            copied[handle] = args[node.var.slot];
+            return;
+        }
+
+        if(node.type == Expression::TEMP)
+        {
+            auto it = tempSlots.find(node.temp.slot);
+            if(it == tempSlots.end())
+                it = tempSlots.emplace(node.temp.slot, firstTemp + numTemps++).first;
+            node.temp.slot = it->second;
+        }
+
+        //copies are the caller's own, so they take the positions they had in the target
+        ExpressionHandle result = add_node(ast, node);
+        Expression& copy = ast->get_exp(result);
+        ast->relocate(arms[0], copy.line, copy.charIdx);
+        for_each_child(copy, [&](ExpressionHandle& child) { child = copied.at(child); });
+        if(copy.type == Expression::TEMP && is_literal(ast->get_exp(copy.temp.exp)))
+            copied[handle] = copy.temp.exp;
+        else
+            copied[handle] = fold_literals(ast, result);
+    });
+
+    return copied.at(arms[0].first);
+}
+
+void optimize_hot_function(AST* ast, Function* func)
+{
+    if(func->hot || !func->parsed)
+        return;
+
+    int32_t numTemps = func->numTemps;
+    auto arms = rebuild_arms(ast, func, [&](ExpressionHandle handle)
+    {
+        if(ast->get_exp(handle).type == Expression::FUNCTION)
+            return inline_call(ast, func, numTemps, handle);
+        return fold_literals(ast, handle);
+    });
+
+    func->hotMap = drop_dead_arms(ast, arms);
+    func->hotTemps = numTemps;
+    func->hot = true;
+}
+
+//------------------------------------------------------
+//non-static func definitions:
+
+void optimize_function(AST* ast, Function* func)
+{
+    if(!func->parsed || func->optimized)
+        return;
+
+    if(ast->passes.armProfile)
+        reorder_arms(ast, func);
+    if(ast->passes.cse)
+        eliminate_common_subexpressions(ast, func);
+
+    func->optimized = true;
+}
+
+void optimize_program(AST* ast)
+{
+    for(Function& func : ast->functions)
+        optimize_function(ast, &func);
+
+    if(ast->passes.cloneBudget > 0)
+        specialize_constant_arguments(ast);
+}
@@ -0,0 +1,31 @@
+#ifndef OPAL_OPTIMIZER_H
+#define OPAL_OPTIMIZER_H
+
+#include "ast.hpp"
+
+//runs the load-time passes enabled in ast->passes on every parsed function
+void optimize_program(AST* ast);
+//runs the load-time passes enabled in ast->passes on one parsed function
+void optimize_function(AST* ast, Function* func);
+
+//hoists pure subexpressions repeated across the guards and bodies of func into
+//temporaries, evaluated at most once per call and only when first needed
+void eliminate_common_subexpressions(AST* ast, Function* func);
+
+//clones functions for the constant args they're most often called with, up to
+//ast->passes.cloneBudget clones, and points those calls at the clones. constants are
+//folded into each clone and the arms they rule out are dropped. only functions parsed
+//by now take part, so lazily loaded ones are left alone
+void specialize_constant_arguments(AST* ast);
+
+//moves the arms of func taken most often in ast->passes.armProfile ahead of colder
+//ones, as long as the arms passed over provably never hold for the same args. a hot
+//otherwise arm gets a copy guarded by the range the arms it passes over leave uncovered
+void reorder_arms(AST* ast, Function* func);
+
+//builds func's hot arms: calls to small functions of one unconditional arm are
+//inlined, literals folded, and arms whose guards fold away dropped. may run while func
+//is being evaluated, since it only adds nodes
+void optimize_hot_function(AST* ast, Function* func);
+
+#endif
@@ -0,0 +1,148 @@
+#include "output.hpp"
+#include <charconv>
+#include <string.h>
+
+size_t format_value(Value value, char* out)
+{
+	char* end = out + MAX_VALUE_CHARS;
+	switch(value.type())
+	{
+	case Value::INT:
+		return std::to_chars(out, end, value.as_int()).ptr - out;
+	case Value::BOOL:
+		out[0] = value.as_bool() ? '1' : '0';
+		return 1;
+	case Value::FLOAT:
+	{
+		char* last = std::to_chars(out, end, value.as_float()).ptr;
+		bool isIntegral = true;
+		for(char* c = out; c < last; c++)
+			if(*c == '.' || *c == 'e' || *c == 'n' || *c == 'i') //decimal, exponent, nan or inf
+				isIntegral = false;
+
+		if(isIntegral)
+		{
+			*last++ = '.';
+			*last++ = '0';
+		}
+		return last - out;
+	}
+	case Value::ARRAY:
+	{
+		char* last = out;
+		*last++ = '[';
+		for(size_t i = 0; i < value.array_length(); i++)
+		{
+			if(i > 0)
+				*last++ = ',';
+			last += format_value(Value(value.array_elements()[i]), last);
+		}
+		*last++ = ']';
+		return last - out;
+	}
+	}
+
+	return 0;
+}
+
+OutputWriter::OutputWriter(FILE* file, OutputFormat format, size_t capacity) : file(file), format(format), buffer(capacity), used(0)
+{
+}
+
+OutputWriter::~OutputWriter()
+{
+	flush();
+}
+
+char* OutputWriter::reserve(size_t n)
+{
+	if(used + n > buffer.size())
+	{
+		flush();
+		if(n > buffer.size())
+			buffer.resize(n);
+	}
+
+	char* out = buffer.data() + used;
+	used += n;
+	return out;
+}
+
+void OutputWriter::write_args(const std::vector<std::string>& args)
+{
+	if(format != OUTPUT_TSV)
+		return;
+
+	for(const std::string& arg : args)
+	{
+		char* out = reserve(arg.size() + 1);
+		memcpy(out, arg.data(), arg.size());
+		out[arg.size()] = '\t';
+	}
+}
+
+void OutputWriter::write_result(Value result)
+{
+	if(format == OUTPUT_BINARY)
+	{
+		if(result.is_array())
+		{
+			const int64_t length = result.array_length();
+			char* out = reserve(8 + length * 8);
+			memcpy(out, &length, 8);
+			memcpy(out + 8, result.array_elements(), length * 8);
+			return;
+		}
+
+		char* out = reserve(8);
+		if(result.is_float())
+		{
+			double f = result.as_float();
+			memcpy(out, &f, 8);
+		}
+		else
+		{
+			int64_t i = result.get_int();
+			memcpy(out, &i, 8);
+		}
+		return;
+	}
+
+	const size_t maxChars = max_value_chars(result);
+	char* out = reserve(maxChars + 1);
+	size_t length = format_value(result, out);
+	out[length] = '\n';
+	used -= maxChars - length;
+}
+
+void OutputWriter::write_result(const std::vector<std::string>& args, Value result)
+{
+	write_args(args);
+	write_result(result);
+}
+
+void OutputWriter::write_error(const std::vector<std::string>& args, const char* message)
+{
+	if(format == OUTPUT_BINARY)
+	{
+		flush();
+		fprintf(stderr, "%s\n", message);
+		return;
+	}
+
+	write_args(args);
+
+	const size_t length = strlen(message);
+	char* out = reserve(length + 1);
+	memcpy(out, message, length);
+	out[length] = '\n';
+}
+
+void OutputWriter::flush()
+{
+	if(used > 0)
+		fwrite(buffer.data(), 1, used, file);
+	used = 0;
+
+	fflush(file);
+}
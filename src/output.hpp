@@ -0,0 +1,57 @@
+#ifndef OPAL_OUTPUT_H
+#define OPAL_OUTPUT_H
+
+#include "value.hpp"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+enum OutputFormat
+{
+	OUTPUT_TEXT,   //one result per line
+	OUTPUT_TSV,    //the arguments, then the result, separated by tabs
+	OUTPUT_BINARY  //8 bytes per result: int64 for ints and bools, double for floats. arrays
+	               //are an int64 length followed by their elements
+};
+
+//longest text format_value can write for a scalar
+constexpr size_t MAX_VALUE_CHARS = 32;
+
+//longest text format_value can write for value, arrays included
+inline size_t max_value_chars(Value value)
+{
+	if(value.is_array())
+		return 2 + value.array_length() * (MAX_VALUE_CHARS + 1);
+	return MAX_VALUE_CHARS;
+}
+
+//writes the shortest text that reads back as the same value; floats always keep a
+//decimal point or exponent so they can't be mistaken for ints. arrays are written as
+//their elements, comma separated, between brackets
+size_t format_value(Value value, char* out);
+
+//formats results into one large reusable buffer, only writing it out when it fills up
+class OutputWriter
+{
+	FILE* file;
+	OutputFormat format;
+	std::vector<char> buffer;
+	size_t used;
+
+	char* reserve(size_t n);
+	//the args ahead of a tsv line
+	void write_args(const std::vector<std::string>& args);
+
+public:
+	OutputWriter(FILE* file, OutputFormat format, size_t capacity = 1 << 20);
+	~OutputWriter();
+
+	void write_result(Value result);
+	void write_result(const std::vector<std::string>& args, Value result);
+	//writes message in place of a result, as a line of its own. binary output can't hold
+	//text, so there it goes to stderr once the results before it are written
+	void write_error(const std::vector<std::string>& args, const char* message);
+	void flush();
+};
+
+#endif
@@ -1,8 +1,11 @@
 #include "parser.hpp"
+#include "lexer.hpp"
+#include "stats.hpp"
+#include "optimizer.hpp"
+#include "arrays.hpp"
 #include <iostream>
 #include <string>
 #include <string.h>
-#include <stack>
 
 //------------------------------------------------------
 //base parse error:
@@ -66,78 +69,142 @@ public:
 //------------------------------------------------------
 //static func declarations:
 
-static Function parse_function(AST* ast, std::vector<Token>& tokens, size_t& pos);
-static ExpressionHandle parse_expression(AST* ast, std::vector<Token>& tokens, size_t& pos, int32_t parenDepth);
-
-static ExpressionHandle parse_iden_lit(AST* ast, std::vector<Token>& tokens, size_t& pos, int32_t parenDepth);
-static ExpressionHandle parse_op(AST* ast, std::vector<Token>& tokens, size_t& pos, int32_t parenDepth);
+static Function parse_function(AST* ast, TokenStream& tokens, bool lazy);
+static void parse_function_body(AST* ast, TokenStream& tokens, Function& func);
+static ExpressionHandle parse_expression(AST* ast, TokenStream& tokens);
 
 //------------------------------------------------------
 //helper func definitions:
 
-inline static void remove_newline_tokens(std::vector<Token>& tokens, size_t& pos)
+inline static void remove_newline_tokens(TokenStream& tokens)
 {
-    while(tokens[pos].type == Token::NEWLINE && pos < tokens.size())
-        pos++;   
+    while(tokens.peek().type == Token::NEWLINE)
+        tokens.next();
 }
 
-inline static Token next_token_keep_newline(std::vector<Token>& tokens, size_t& pos)
+inline static Token next_token_keep_newline(TokenStream& tokens)
 {
-    if(pos >= tokens.size())
-        return Token(Token::EMPTY, 0, 0);
-    else
-        return tokens[pos++];
+    return tokens.next();
 }
 
-inline static Token next_token_skip_newline(std::vector<Token>& tokens, size_t& pos)
+inline static Token next_token_skip_newline(TokenStream& tokens)
 {
-    remove_newline_tokens(tokens, pos);
-    return next_token_keep_newline(tokens, pos);
+    remove_newline_tokens(tokens);
+    return next_token_keep_newline(tokens);
 }
 
-inline static Token next_token(std::vector<Token>& tokens, size_t& pos, int32_t parenDepth)
+inline static Token next_token(TokenStream& tokens, int32_t parenDepth)
 {
     if(parenDepth == 0)
-        return next_token_keep_newline(tokens, pos);
+        return next_token_keep_newline(tokens);
     else
-        return next_token_skip_newline(tokens, pos);
+        return next_token_skip_newline(tokens);
+}
+
+//newlines never repeat, so looking past one is as far as the stream needs to see
+inline static const Token& peek_token(TokenStream& tokens, int32_t parenDepth)
+{
+    if(parenDepth != 0 && tokens.peek().type == Token::NEWLINE)
+        return tokens.peek(1);
+    return tokens.peek();
+}
+
+inline static bool is_separator(const Token& token, Separator sep)
+{
+    return token.type == Token::SEPARATOR && token.sep == sep;
 }
 
 //------------------------------------------------------
 //non-static func definitions:
 
-AST* generate_ast(std::vector<Token>& tokens)
+AST* generate_ast(TokenStream& tokens, bool lazy)
 {
     AST* ast = new AST;
-    size_t pos = 0;
-    
-    remove_newline_tokens(tokens, pos);
 
-    while(pos < tokens.size())
+    try
     {
-        ast->functions.push_back(parse_function(ast, tokens, pos));
-        remove_newline_tokens(tokens, pos);
+        remove_newline_tokens(tokens);
+
+        while(tokens.peek().type != Token::EMPTY)
+        {
+            if(tokens.peek().type == Token::OPERATOR && tokens.peek().op == IMPORT)
+            {
+                const Token first = tokens.next();
+                const Token name = next_token_keep_newline(tokens);
+                if(name.type != Token::IDENTIFIER)
+                    throw new ParseErrorExpectedIdentifier(name.line, name.charIdx);
+
+                ast->imports.push_back({std::string(name.iden), first.line, first.charIdx});
+            }
+            else
+                ast->add_function(parse_function(ast, tokens, lazy));
+
+            remove_newline_tokens(tokens);
+        }
+    }
+    catch(...)
+    {
+        free_ast(ast);
+        throw;
     }
 
+    OPAL_STAT_ADD(expressions, ast->num_exps());
     return ast;
 }
 
+void parse_lazy_function(AST* ast, Function* func)
+{
+    if(func->parsed)
+        return;
+
+    size_t numExps = ast->num_exps();
+
+    TokenStream tokens(ast->tokens.data() + func->bodyBegin, ast->tokens.data() + func->bodyEnd + 1);
+    parse_function_body(ast, tokens, *func);
+    func->parsed = true;
+
+    OPAL_STAT_ADD(expressions, ast->num_exps() - numExps);
+    optimize_function(ast, func);
+}
+
+void merge_ast(AST* ast, AST* other)
+{
+    for(Function& func : other->functions)
+        if(ast->find_function(func.name) != nullptr)
+            throw new ParseErrorFunctionRedef(func.name, func.nameLine, func.nameCharIdx);
+
+    ast->merge(*other);
+}
+
 void free_ast(AST* ast)
 {
-    //TODO: free strings + arrays
+    //every node owns its name and params, even where nodes were copied
+    for(size_t i = 0; i < ast->num_exps(); i++)
+    {
+        Expression& exp = ast->get_exp(i);
+        if(exp.type == Expression::FUNCTION)
+        {
+            free_identifier(exp.func.name);
+            mem_delete_array(MEM_CALL_PARAMS, exp.func.params, exp.func.numParams);
+        }
+        else if(exp.type == Expression::VARIABLE)
+            free_identifier(exp.var.name);
+    }
+
+    free_tokens(ast->tokens);
     delete ast;
 }
 
 //------------------------------------------------------
 //static func definitions:
 
-static Function parse_function(AST* ast, std::vector<Token>& tokens, size_t& pos)
+static Function parse_function(AST* ast, TokenStream& tokens, bool lazy)
 {
     Function func;
 
     //ensure function is declared properly:
     //----------------
-    Token declare = next_token_skip_newline(tokens, pos);
+    Token declare = next_token_skip_newline(tokens);
     if(declare.type != Token::OPERATOR || declare.op != FN)
         throw new ParseErrorExpectedFunction(declare.line, declare.charIdx);
     
@@ -145,45 +212,77 @@ static Function parse_function(AST* ast, std::vector<Token>& tokens, size_t& pos
 
     //ensure name is an idenfifier and is unique:
     //----------------
-    Token name = next_token_skip_newline(tokens, pos);
+    Token name = next_token_skip_newline(tokens);
     if(name.type != Token::IDENTIFIER)
         throw new ParseErrorExpectedIdentifier(name.line, name.charIdx);
 
-    for(int32_t i = 0; i < ast->functions.size(); i++)
-        if(strcmp(name.iden, ast->functions[i].name.c_str()) == 0)
-            throw new ParseErrorFunctionRedef(ast->functions[i].name, name.line, name.charIdx);
-
     func.name = std::string(name.iden);
+    func.nameLine = name.line;
+    func.nameCharIdx = name.charIdx;
+    if(ast->find_function(func.name) != nullptr)
+        throw new ParseErrorFunctionRedef(func.name, name.line, name.charIdx);
 
     //parse arguments (if any)
     //----------------
-    Token of = next_token_skip_newline(tokens, pos);
-    if(of.type == Token::OPERATOR && of.op == OF)
+    remove_newline_tokens(tokens);
+    if(tokens.peek().type == Token::OPERATOR && tokens.peek().op == OF)
     {
-        Token param = next_token_skip_newline(tokens, pos);
-        while(param.type == Token::IDENTIFIER)
+        tokens.next();
+        remove_newline_tokens(tokens);
+        while(tokens.peek().type == Token::IDENTIFIER)
         {
-            for(int i = 0; i < func.params.size(); i++)
-                if(strcmp(name.iden, func.params[i].c_str()) == 0)
+            Token param = tokens.next();
+            for(size_t i = 0; i < func.params.size(); i++)
+                if(strcmp(param.iden, func.params[i].c_str()) == 0)
                     throw new ParseErrorParamRedef(func.params[i].c_str(), param.line, param.charIdx);
             
             func.params.push_back(std::string(param.iden));
-            param = next_token_skip_newline(tokens, pos);
+            remove_newline_tokens(tokens);
         }
-
-        pos--;
     }
-    else
-        pos--;
 
-    //parse expressions:
+    //find the body:
     //----------------
-    Token openBrace = next_token_skip_newline(tokens, pos);
+    Token openBrace = next_token_skip_newline(tokens);
     if(openBrace.type != Token::SEPARATOR || openBrace.sep != OPEN_CURLY)
         throw new ParseErrorExpectedSeparator(openBrace.line, openBrace.charIdx);
-    
-    ExpressionHandle firstExp = parse_expression(ast, tokens, pos, 0);
-    Token firstExpEnd = next_token_skip_newline(tokens, pos);
+
+    if(!lazy)
+    {
+        parse_function_body(ast, tokens, func);
+        return func;
+    }
+
+    //bodies can't contain braces, so the first closing one ends the function. its
+    //tokens are kept, up to and including that brace, with identifiers of their own
+    func.bodyBegin = ast->tokens.size();
+    while(true)
+    {
+        Token token = tokens.next();
+        if(token.type == Token::EMPTY)
+            throw new ParseErrorExpectedSeparator(openBrace.line, openBrace.charIdx);
+        if(token.type == Token::IDENTIFIER)
+            token.iden = copy_identifier(token.iden);
+
+        ast->tokens.push_back(token);
+        if(is_separator(token, CLOSE_CURLY))
+            break;
+    }
+
+    func.bodyEnd = ast->tokens.size() - 1;
+    func.parsed = false;
+
+    return func;
+}
+
+static void parse_function_body(AST* ast, TokenStream& tokens, Function& func)
+{
+    const size_t bodyBegin = ast->num_exps();
+
+    //parse expressions:
+    //----------------
+    ExpressionHandle firstExp = parse_expression(ast, tokens);
+    Token firstExpEnd = next_token_skip_newline(tokens);
     if(firstExpEnd.type == Token::SEPARATOR && firstExpEnd.sep == CLOSE_CURLY) //single case function
     {
         Expression otherwise(firstExpEnd.line, firstExpEnd.charIdx);
@@ -194,190 +293,308 @@ static Function parse_function(AST* ast, std::vector<Token>& tokens, size_t& pos
     }
     else if(firstExpEnd.type == Token::SEPARATOR && firstExpEnd.sep == COLON) //multi case function
     {
-        ExpressionHandle firstCond = parse_expression(ast, tokens, pos, 0);
+        ExpressionHandle firstCond = parse_expression(ast, tokens);
         func.map.push_back({firstExp, firstCond});
 
-        Token end = next_token_skip_newline(tokens, pos);
-        while(end.type != Token::SEPARATOR || end.sep != CLOSE_CURLY)
+        remove_newline_tokens(tokens);
+        while(!is_separator(tokens.peek(), CLOSE_CURLY))
         {
-            pos--;
-            ExpressionHandle exp = parse_expression(ast, tokens, pos, 0);
+            ExpressionHandle exp = parse_expression(ast, tokens);
 
-            Token colon = next_token_skip_newline(tokens, pos);
+            Token colon = next_token_skip_newline(tokens);
             if(colon.type != Token::SEPARATOR || colon.sep != COLON)
                 throw new ParseErrorExpectedSeparator(colon.line, colon.charIdx);
 
-            ExpressionHandle cond = parse_expression(ast, tokens, pos, 0);
+            ExpressionHandle cond = parse_expression(ast, tokens);
 
             func.map.push_back({exp, cond});
-            end = next_token_skip_newline(tokens, pos);
+            remove_newline_tokens(tokens);
         }
+
+        tokens.next();
     }
     else
         throw new ParseErrorExpectedSeparator(firstExpEnd.line, firstExpEnd.charIdx);
 
-    return func;
-} 
-
-static ExpressionHandle parse_expression(AST* ast, std::vector<Token>& tokens, size_t& pos, int32_t parenDepth)
-{
-    remove_newline_tokens(tokens, pos);
-
-    Token nextToken = next_token(tokens, pos, parenDepth);
-    if(nextToken.type == Token::OPERATOR && nextToken.op == OTHERWISE)
+    //resolve variables to param slots, the last param with a name shadowing earlier ones:
+    //----------------
+    for(size_t i = bodyBegin; i < ast->num_exps(); i++)
     {
-        Expression exp(nextToken.line, nextToken.charIdx);
-        exp.type = Expression::OPERATOR;
-        exp.op.op = OTHERWISE;
-
-        return ast->add_exp(exp);
+        Expression& exp = ast->get_exp(i);
+        if(exp.type != Expression::VARIABLE)
+            continue;
+
+        exp.var.slot = -1;
+        for(int32_t j = (int32_t)func.params.size() - 1; j >= 0 && exp.var.slot < 0; j--)
+            if(func.params[j] == exp.var.name)
+                exp.var.slot = j;
     }
-    else
-        pos--;
 
-    //shunting yard:
-    std::stack<ExpressionHandle> nums;
-    std::stack<ExpressionHandle> ops;
+    //slots are known now, so equal subtrees can share a node. a shared node stands for
+    //each of its occurrences, so passes counting uses count paths to it, not nodes:
+    //----------------
+    ast->intern(bodyBegin, &func, 1, ast->relocations);
+}
+
+//------------------------------------------------------
+//expression parsing:
 
-    while(true)
+//pratt parser driven by an explicit frame stack instead of native recursion, so heavily
+//nested sources can't overflow the stack. a frame is pushed whenever an operand has to be
+//parsed before a construct can be completed, and popped once the next token can no longer
+//extend that operand.
+struct PrattFrame
+{
+    enum Kind
     {
-        nums.push(parse_iden_lit(ast, tokens, pos, parenDepth));
-        
-        Token nextToken = next_token(tokens, pos, parenDepth); pos--;
-        if(nextToken.type != Token::OPERATOR)
-            break;
+        INFIX,
+        NEGATE,
+        PAREN,
+        CALL,
+        ARRAY, //array literal, a call of the builtin that makes it
+        INDEX
+    } kind;
+
+    int32_t minBp;          //binding power to restore once the frame is closed
+    ExpressionHandle lhs;   //INFIX: left operand, INDEX: indexed array
+    Token token;            //operator, minus, open paren or bracket, or function name
+    size_t argBase;         //CALL, ARRAY: first argument of this call in the argument scratch
+    size_t nameBase;        //CALL: the function name in the name scratch
+};
 
-        ExpressionHandle op = parse_op(ast, tokens, pos, parenDepth);
-        if(!ops.empty() && ORDER_OF_OPERATIONS.at(ast->get_exp(op).op.op) <= ORDER_OF_OPERATIONS.at(ast->get_exp(ops.top()).op.op))
-        {
-            while(!ops.empty())
-            {
-                ExpressionHandle evaledOp = ops.top(); ops.pop();
-                
-                ast->get_exp(evaledOp).op.right = nums.top(); nums.pop();
-                ast->get_exp(evaledOp).op.left = nums.top(); nums.pop();
+//scratch reused by every parse on a thread so steady state parsing doesn't allocate
+static thread_local std::vector<PrattFrame> prattFrames;
+static thread_local std::vector<ExpressionHandle> prattArgs;
+//names of the calls whose args are being parsed, as the stream only keeps identifiers
+//valid for a few tokens after theirs
+static thread_local std::vector<char> prattNames;
 
-                nums.push(evaledOp);
-            }
-        }
+static ExpressionHandle make_operator(AST* ast, const Token& token, Operator op, ExpressionHandle left, ExpressionHandle right)
+{
+    Expression exp(token.line, token.charIdx);
+    exp.type = Expression::OPERATOR;
+    exp.op.op = op;
+    exp.op.parenDepth = 0;
+    exp.op.left = left;
+    exp.op.right = right;
 
-        ops.push(op);
-    }
+    return ast->add_exp(exp);
+}
 
-    while(!ops.empty())
+static ExpressionHandle make_operand(AST* ast, const Token& token)
+{
+    Expression exp(token.line, token.charIdx);
+    switch(token.type)
     {
-        ExpressionHandle evaledOp = ops.top(); ops.pop();
-                
-        ast->get_exp(evaledOp).op.right = nums.top(); nums.pop();
-        ast->get_exp(evaledOp).op.left = nums.top(); nums.pop();
-
-        nums.push(evaledOp);
+    case Token::IDENTIFIER:
+        exp.type = Expression::VARIABLE;
+        exp.var.name = copy_identifier(token.iden);
+        exp.var.slot = -1;
+        break;
+    case Token::INT_LITERAL:
+        exp.type = Expression::INT_LITERAL;
+        exp.intLit.val = token.intLit;
+        break;
+    case Token::FLOAT_LITERAL:
+        exp.type = Expression::FLOAT_LITERAL;
+        exp.floatLit.val = token.floatLit;
+        break;
+    default:
+        throw new ParseErrorExpectedIdentifier(token.line, token.charIdx);
     }
 
-    return nums.top();
+    return ast->add_exp(exp);
 }
 
-//------------------------------------------------------
-//static func definitions:
+static ExpressionHandle make_call(AST* ast, const Token& at, const char* name, const ExpressionHandle* params, size_t numParams)
+{
+    Expression exp(at.line, at.charIdx);
+    exp.type = Expression::FUNCTION;
+    exp.func.name = copy_identifier(name);
+    exp.func.numParams = numParams;
+    exp.func.params = mem_new_array<ExpressionHandle>(MEM_CALL_PARAMS, numParams);
+    exp.func.target = -1;
+    if(numParams > 0)
+        memcpy(exp.func.params, params, numParams * sizeof(ExpressionHandle));
 
-static ExpressionHandle parse_iden_lit(AST* ast, std::vector<Token>& tokens, size_t& pos, int32_t parenDepth)
+    return ast->add_exp(exp);
+}
+
+static ExpressionHandle parse_expression(AST* ast, TokenStream& tokens)
 {
-    Token token = next_token(tokens, pos, parenDepth);
-    if(token.type == Token::SEPARATOR && token.sep == OPEN_PAREN) //in parenthesis
+    remove_newline_tokens(tokens);
+
+    if(tokens.peek().type == Token::OPERATOR && tokens.peek().op == OTHERWISE)
     {
-        ExpressionHandle exp = parse_expression(ast, tokens, pos, parenDepth + 1);
+        const Token first = tokens.next();
 
-        Token closeParen = next_token(tokens, pos, parenDepth + 1);
-        if(closeParen.type != Token::SEPARATOR || token.sep != CLOSE_PAREN)
-            throw new ParseErrorExpectedSeparator(closeParen.line, closeParen.charIdx);
+        Expression exp(first.line, first.charIdx);
+        exp.type = Expression::OPERATOR;
+        exp.op.op = OTHERWISE;
 
-        return exp;   
+        return ast->add_exp(exp);
     }
 
-    if(token.type == Token::OPERATOR && token.op == SUB) //multiplying by -1
-    {
-        Expression minus1(token.line, token.charIdx);
-        minus1.type = Expression::INT_LITERAL;
-        minus1.intLit.val = -1;
-        ExpressionHandle hMinus1 = ast->add_exp(minus1);
-
-        Expression mult(token.line, token.charIdx);
-        mult.type = Expression::OPERATOR;
-        mult.op.op = MULT;
-        mult.op.left = hMinus1;
-        mult.op.right = parse_iden_lit(ast, tokens, pos, parenDepth);
-
-        return ast->add_exp(mult);
-    }
+    std::vector<PrattFrame>& frames = prattFrames;
+    std::vector<ExpressionHandle>& args = prattArgs;
+    std::vector<char>& names = prattNames;
+    frames.clear();
+    args.clear();
+    names.clear();
 
-    Expression exp(token.line, token.charIdx);
-    switch(token.type)
-    {
-    case Token::IDENTIFIER:
+    int32_t parenDepth = 0; //newlines only end the expression outside of parenthesis
+    int32_t minBp = 0;
+    ExpressionHandle lhs;
+
+    while(true)
     {
-        Token nextToken = next_token(tokens, pos, parenDepth);
-        if(nextToken.type == Token::SEPARATOR && nextToken.sep == OPEN_PAREN) //function
+        //operand position:
+        //----------------
+        const Token token = next_token(tokens, parenDepth);
+        if(is_separator(token, OPEN_PAREN))
+        {
+            frames.push_back({PrattFrame::PAREN, minBp, 0, token, 0, 0});
+            parenDepth++;
+            minBp = 0;
+            continue;
+        }
+
+        if(token.type == Token::OPERATOR && token.op == SUB) //multiplying by -1
         {
-            exp.type = Expression::FUNCTION;
-            exp.func.name = new char[strlen(token.iden)];
-            strcpy(exp.var.name, token.iden);
+            frames.push_back({PrattFrame::NEGATE, minBp, 0, token, 0, 0});
+            minBp = PREFIX_BINDING_POWER;
+            continue;
+        }
 
-            std::vector<ExpressionHandle> params;
+        if(token.type == Token::IDENTIFIER && is_separator(peek_token(tokens, parenDepth), OPEN_PAREN)) //function
+        {
+            next_token(tokens, parenDepth);
+            parenDepth++;
 
-            while(nextToken.type != Token::SEPARATOR || nextToken.sep != CLOSE_PAREN)
+            if(is_separator(peek_token(tokens, parenDepth), CLOSE_PAREN))
             {
-                params.push_back(parse_expression(ast, tokens, pos, parenDepth + 1));
-                nextToken = next_token(tokens, pos, parenDepth + 1);
-
-                if(nextToken.type != Token::SEPARATOR || (nextToken.sep != CLOSE_PAREN && nextToken.sep != COMMA))
-                    throw new ParseErrorExpectedSeparator(nextToken.line, nextToken.charIdx);
+                next_token(tokens, parenDepth);
+                parenDepth--;
+                lhs = make_call(ast, token, token.iden, nullptr, 0);
+            }
+            else
+            {
+                frames.push_back({PrattFrame::CALL, minBp, 0, token, args.size(), names.size()});
+                names.insert(names.end(), token.iden, token.iden + strlen(token.iden) + 1);
+                minBp = 0;
+                continue;
             }
-
-            exp.func.numParams = params.size();
-            exp.func.params = new ExpressionHandle[exp.func.numParams];
-            memcpy(exp.func.params, params.data(), exp.func.numParams * sizeof(ExpressionHandle));
         }
-        else //variable
+        else if(is_separator(token, OPEN_BRACKET)) //array literal
         {
-            pos--;
+            parenDepth++;
 
-            exp.type = Expression::VARIABLE;
-            exp.var.name = new char[strlen(token.iden)];
-            strcpy(exp.var.name, token.iden);
+            if(is_separator(peek_token(tokens, parenDepth), CLOSE_BRACKET))
+            {
+                next_token(tokens, parenDepth);
+                parenDepth--;
+                lhs = make_call(ast, token, ARRAY_LITERAL_NAME, nullptr, 0);
+            }
+            else
+            {
+                frames.push_back({PrattFrame::ARRAY, minBp, 0, token, args.size(), 0});
+                minBp = 0;
+                continue;
+            }
         }
+        else
+            lhs = make_operand(ast, token);
 
-        break;
-    }
-    case Token::INT_LITERAL:
-    {
-        exp.type = Expression::INT_LITERAL;
-        exp.intLit.val = token.intLit;
+        //operator position:
+        //----------------
+        while(true)
+        {
+            const Token& op = peek_token(tokens, parenDepth);
+            if(is_separator(op, OPEN_BRACKET)) //indexing binds tighter than any operator
+            {
+                frames.push_back({PrattFrame::INDEX, minBp, lhs, op, 0, 0});
+                next_token(tokens, parenDepth);
+                parenDepth++;
+                minBp = 0;
+                break;
+            }
 
-        break;
-    }
-    case Token::FLOAT_LITERAL:
-    {
-        exp.type = Expression::FLOAT_LITERAL;
-        exp.floatLit.val = token.floatLit;
+            //fn, of and otherwise never follow an operand
+            if(op.type == Token::OPERATOR && !is_infix(op.op))
+                throw new ParseErrorExpectedSeparator(op.line, op.charIdx);
 
-        break;
-    }
-    default:
-        throw new ParseErrorExpectedIdentifier(token.line, token.charIdx);
-    }
+            if(op.type == Token::OPERATOR && is_infix(op.op) && binding_power(op.op).left >= minBp)
+            {
+                frames.push_back({PrattFrame::INFIX, minBp, lhs, op, 0, 0});
+                next_token(tokens, parenDepth);
+                minBp = binding_power(op.op).right;
+                break;
+            }
 
-    return ast->add_exp(exp);
-}
+            if(frames.empty())
+                return lhs;
 
-static ExpressionHandle parse_op(AST* ast, std::vector<Token>& tokens, size_t& pos, int32_t parenDepth)
-{
-    Token token = next_token(tokens, pos, parenDepth);
-    if(token.type != Token::OPERATOR || token.op == FN || token.op == OTHERWISE || token.op == OF)
-        throw new ParseErrorExpectedOperator(token.line, token.charIdx);
+            PrattFrame frame = frames.back();
+            if(frame.kind == PrattFrame::INFIX)
+            {
+                frames.pop_back();
+                lhs = make_operator(ast, frame.token, frame.token.op, frame.lhs, lhs);
+            }
+            else if(frame.kind == PrattFrame::NEGATE)
+            {
+                frames.pop_back();
 
-    Expression exp(token.line, token.charIdx);
-    exp.type = Expression::OPERATOR;
-    exp.op.op = token.op;
+                Expression minus1(frame.token.line, frame.token.charIdx);
+                minus1.type = Expression::INT_LITERAL;
+                minus1.intLit.val = -1;
 
-    return ast->add_exp(exp);
-}
\ No newline at end of file
+                lhs = make_operator(ast, frame.token, MULT, ast->add_exp(minus1), lhs);
+            }
+            else if(frame.kind == PrattFrame::PAREN)
+            {
+                const Token closeParen = next_token(tokens, parenDepth);
+                if(!is_separator(closeParen, CLOSE_PAREN))
+                    throw new ParseErrorExpectedSeparator(closeParen.line, closeParen.charIdx);
+
+                frames.pop_back();
+                parenDepth--;
+            }
+            else if(frame.kind == PrattFrame::INDEX)
+            {
+                const Token closeBracket = next_token(tokens, parenDepth);
+                if(!is_separator(closeBracket, CLOSE_BRACKET))
+                    throw new ParseErrorExpectedSeparator(closeBracket.line, closeBracket.charIdx);
+
+                frames.pop_back();
+                parenDepth--;
+
+                const ExpressionHandle params[] = {frame.lhs, lhs};
+                lhs = make_call(ast, frame.token, ARRAY_INDEX_NAME, params, 2);
+            }
+            else //CALL or ARRAY
+            {
+                const Token sep = next_token(tokens, parenDepth);
+                args.push_back(lhs);
+
+                if(is_separator(sep, COMMA))
+                {
+                    minBp = 0;
+                    break;
+                }
+                if(!is_separator(sep, frame.kind == PrattFrame::CALL ? CLOSE_PAREN : CLOSE_BRACKET))
+                    throw new ParseErrorExpectedSeparator(sep.line, sep.charIdx);
+
+                frames.pop_back();
+                parenDepth--;
+
+                const char* name = frame.kind == PrattFrame::CALL ? names.data() + frame.nameBase : ARRAY_LITERAL_NAME;
+                lhs = make_call(ast, frame.token, name, args.data() + frame.argBase, args.size() - frame.argBase);
+                args.resize(frame.argBase);
+                if(frame.kind == PrattFrame::CALL)
+                    names.resize(frame.nameBase);
+            }
+
+            minBp = frame.minBp;
+        }
+    }
+}
@@ -5,7 +5,16 @@
 #include "token.hpp"
 #include <vector>
 
-AST* generate_ast(std::vector<Token>& tokens);
+class TokenStream;
+
+//parses tokens as they're pulled from the stream. with lazy set, function bodies are
+//only located, and the AST keeps a copy of their tokens
+AST* generate_ast(TokenStream& tokens, bool lazy = false);
+//parses the body of a lazily loaded function and runs the load-time passes on it,
+//if it hasn't been already
+void parse_lazy_function(AST* ast, Function* func);
+//moves the functions of other into ast, throwing on redefinitions
+void merge_ast(AST* ast, AST* other);
 void free_ast(AST* ast);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "profile.hpp"
+#include <fstream>
+#include <sstream>
+
+bool read_arm_profile(const std::string& fileName, ArmProfile& profile)
+{
+    std::ifstream file(fileName);
+    if(!file.good())
+        return false;
+
+    std::string line;
+    while(std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string name;
+        size_t numArms;
+        if(!(fields >> name))
+            continue;
+        if(!(fields >> numArms))
+            return false;
+
+        std::vector<uint64_t> hits(numArms);
+        for(uint64_t& count : hits)
+        {
+            if(!(fields >> count))
+                return false;
+        }
+        profile[name] = std::move(hits);
+    }
+    return true;
+}
+
+bool write_arm_profile(const std::string& fileName, const AST* ast)
+{
+    std::ofstream file(fileName);
+    if(!file.good())
+        return false;
+
+    for(const Function& func : ast->functions)
+    {
+        if(func.armHits.empty())
+            continue;
+
+        file << func.name << " " << func.armHits.size();
+        for(uint64_t count : func.armHits)
+            file << " " << count;
+        file << "\n";
+    }
+    return file.good();
+}
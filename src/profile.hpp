@@ -0,0 +1,19 @@
+#ifndef OPAL_PROFILE_H
+#define OPAL_PROFILE_H
+
+#include "ast.hpp"
+#include <string>
+
+//------------------------------------------------------
+//arm profiles:
+//
+//a profile holds a line per function that was called: its name, its number of arms,
+//then how many times each arm was taken. functions whose number of arms no longer
+//matches are left in source order by reorder_arms
+
+//false if the file can't be read or a line is malformed
+bool read_arm_profile(const std::string& fileName, ArmProfile& profile);
+//writes the Function::armHits counted while ast ran. false if the file can't be written
+bool write_arm_profile(const std::string& fileName, const AST* ast);
+
+#endif
@@ -0,0 +1,250 @@
+#include "result_cache.hpp"
+#include "loader.hpp"
+#include <atomic>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+thread_local ResultCalls resultCalls;
+
+//------------------------------------------------------
+//file layout:
+
+constexpr uint64_t CACHE_MAGIC = 0x3168636c61706full; //"opalch1", also catching files of the other byte order
+constexpr uint32_t CACHE_VERSION = 1;
+
+//mixed into every key. bump it whenever a change to opal can change what a program
+//evaluates to, so results of the old semantics are never found again
+constexpr uint64_t SEMANTICS_VERSION = 1;
+
+//lookups give up after this many slots, so a nearly full table stays fast
+constexpr int32_t MAX_PROBES = 64;
+
+struct CacheHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slotSize;
+    uint64_t numSlots; //a power of two
+    uint64_t reserved;
+};
+
+//a slot is empty while lo is 0, claimed by the first writer to swap its key in, and
+//holds a result once meta is set. the other fields are written before meta, and read
+//after it, so a reader seeing meta set sees them too. a writer dying in between leaves
+//the slot claimed for good, and its key uncached
+struct CacheSlot
+{
+    std::atomic<uint64_t> lo;
+    std::atomic<uint64_t> hi;
+    std::atomic<uint64_t> meta; //1 | Value::Type << 1
+    std::atomic<uint64_t> bits; //the int64, double or bool of the result
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "slots are shared between processes, so they can't use locks");
+static_assert(sizeof(CacheSlot) == 32 && sizeof(CacheHeader) == 32, "the cache file layout must not change");
+
+struct ResultCache
+{
+    void* map;
+    size_t size;
+    CacheSlot* slots;
+    uint64_t mask;
+};
+
+//------------------------------------------------------
+//helper func definitions:
+
+static bool find_result(const ResultCache* cache, const ResultKey& key, Value& result)
+{
+    for(int32_t probe = 0; probe < MAX_PROBES; probe++)
+    {
+        const CacheSlot& slot = cache->slots[(key.hi + probe) & cache->mask];
+        const uint64_t lo = slot.lo.load(std::memory_order_acquire);
+        if(lo == 0)
+            return false;
+        if(lo != key.lo)
+            continue;
+
+        //a key with the same lo may still be being stored, and this one be further on
+        const uint64_t meta = slot.meta.load(std::memory_order_acquire);
+        if(meta == 0 || slot.hi.load(std::memory_order_relaxed) != key.hi)
+            continue;
+
+        const uint64_t bits = slot.bits.load(std::memory_order_relaxed);
+        switch((Value::Type)(meta >> 1))
+        {
+        case Value::INT:
+            result = Value((int64_t)bits);
+            return true;
+        case Value::BOOL:
+            result = Value(bits != 0);
+            return true;
+        default:
+            result = Value::from_bits(bits);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void store_result(ResultCache* cache, const ResultKey& key, Value result)
+{
+    if(result.is_array())
+        return;
+
+    const uint64_t meta = 1 | (uint64_t)result.type() << 1;
+    const uint64_t bits = result.is_int() ? (uint64_t)result.as_int() : result.is_bool() ? (uint64_t)result.as_bool() : result.bits;
+    for(int32_t probe = 0; probe < MAX_PROBES; probe++)
+    {
+        CacheSlot& slot = cache->slots[(key.hi + probe) & cache->mask];
+        uint64_t lo = slot.lo.load(std::memory_order_acquire);
+        if(lo == 0 && slot.lo.compare_exchange_strong(lo, key.lo, std::memory_order_acq_rel))
+        {
+            slot.hi.store(key.hi, std::memory_order_relaxed);
+            slot.bits.store(bits, std::memory_order_relaxed);
+            slot.meta.store(meta, std::memory_order_release);
+            return;
+        }
+
+        //lost the slot, or it was taken before. a writer storing the same key, or one
+        //with the same lo that hasn't published it yet, is left to finish
+        if(lo == key.lo && (slot.meta.load(std::memory_order_acquire) == 0 || slot.hi.load(std::memory_order_relaxed) == key.hi))
+            return;
+    }
+}
+
+//keys chain their words into two hashes, seeded apart
+static void add_word(ResultKey& key, uint64_t word)
+{
+    key.lo = stable_hash(&word, sizeof(word), key.lo);
+    key.hi = stable_hash(&word, sizeof(word), key.hi);
+}
+
+static ResultKey function_key(const Function* func)
+{
+    ResultKey key = {resultCalls.seed, ~resultCalls.seed};
+    add_word(key, func->nameHash);
+    return key;
+}
+
+//key of the marker stored once func has made an expensive call. calls add their number
+//of args next, which is never all ones
+static ResultKey expensive_key(const Function* func)
+{
+    ResultKey key = function_key(func);
+    add_word(key, ~0ull);
+    key.lo |= key.lo == 0;
+    return key;
+}
+
+//------------------------------------------------------
+//non-static func definitions:
+
+ResultCache* open_result_cache(const std::string& fileName, uint64_t numSlots)
+{
+#if defined(_WIN32)
+    return nullptr;
+#else
+    uint64_t slots = 1;
+    while(slots < numSlots && slots < (1ull << 32))
+        slots <<= 1;
+
+    int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(fd < 0)
+        return nullptr;
+
+    //creating the file and checking its header is serialized between processes. the
+    //slots of a new file are all zero, so empty
+    flock(fd, LOCK_EX);
+    struct stat info;
+    CacheHeader header = {};
+    bool valid = fstat(fd, &info) == 0;
+    if(valid && info.st_size == 0)
+    {
+        header = {CACHE_MAGIC, CACHE_VERSION, sizeof(CacheSlot), slots, 0};
+        valid = ftruncate(fd, sizeof(CacheHeader) + slots * sizeof(CacheSlot)) == 0 && pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+    }
+    else if(valid)
+    {
+        valid = pread(fd, &header, sizeof(header), 0) == sizeof(header) && header.magic == CACHE_MAGIC && header.version == CACHE_VERSION &&
+                header.slotSize == sizeof(CacheSlot) && header.numSlots > 0 && (header.numSlots & (header.numSlots - 1)) == 0 &&
+                header.numSlots <= (1ull << 32) && (uint64_t)info.st_size == sizeof(CacheHeader) + header.numSlots * sizeof(CacheSlot);
+    }
+    flock(fd, LOCK_UN);
+
+    const size_t size = sizeof(CacheHeader) + header.numSlots * sizeof(CacheSlot);
+    void* map = valid ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(map == MAP_FAILED)
+        return nullptr;
+
+    return new ResultCache{map, size, (CacheSlot*)((char*)map + sizeof(CacheHeader)), header.numSlots - 1};
+#endif
+}
+
+void close_result_cache(ResultCache* cache)
+{
+#if !defined(_WIN32)
+    munmap(cache->map, cache->size);
+#endif
+    delete cache;
+}
+
+ResultCacheScope::ResultCacheScope(ResultCache* cache, uint64_t sourceHash) : previous(resultCalls)
+{
+    const uint64_t words[2] = {sourceHash, SEMANTICS_VERSION};
+    resultCalls.cache = cache;
+    resultCalls.seed = stable_hash(words, sizeof(words));
+}
+
+ResultCacheScope::~ResultCacheScope()
+{
+    resultCalls = previous;
+}
+
+bool call_key(Function* func, const Value* args, int32_t numArgs, ResultKey& key)
+{
+    if(func->resultCaching == Function::UNCHECKED)
+    {
+        func->nameHash = stable_hash(func->name.data(), func->name.size());
+        Value marker;
+        func->resultCaching = find_result(resultCalls.cache, expensive_key(func), marker) ? Function::EXPENSIVE : Function::CHEAP;
+    }
+
+    //ints are keyed on their value, boxed or not, and floats on their bits, so 0 and -0 differ
+    key = function_key(func);
+    add_word(key, (uint64_t)numArgs);
+    for(int32_t i = 0; i < numArgs; i++)
+    {
+        if(args[i].is_array())
+            return false;
+
+        add_word(key, args[i].type());
+        add_word(key, args[i].is_int() ? (uint64_t)args[i].as_int() : args[i].is_bool() ? (uint64_t)args[i].as_bool() : args[i].bits);
+    }
+
+    //an empty slot's lo is 0, so no key's can be
+    key.lo |= key.lo == 0;
+    return true;
+}
+
+bool find_call_result(Function* func, const ResultKey& key, Value& result)
+{
+    return func->resultCaching == Function::EXPENSIVE && find_result(resultCalls.cache, key, result);
+}
+
+void store_call_result(Function* func, const ResultKey& key, Value result)
+{
+    store_result(resultCalls.cache, key, result);
+    if(func->resultCaching != Function::EXPENSIVE)
+    {
+        func->resultCaching = Function::EXPENSIVE;
+        store_result(resultCalls.cache, expensive_key(func), Value(true));
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef OPAL_RESULT_CACHE_H
+#define OPAL_RESULT_CACHE_H
+
+#include "ast.hpp"
+#include "value.hpp"
+#include <string>
+#include <stdint.h>
+
+//------------------------------------------------------
+//persistent result cache:
+//
+//results of calls, kept in a file every process using it maps in. since opal
+//functions are pure, a result is valid for as long as the sources it came from and
+//the semantics of opal stay the same, across runs and restarts.
+//
+//the file is a fixed number of slots, addressed by open addressing on a 128 bit hash of
+//the program's sources, opal's semantics version, the function called and its args.
+//slots are only ever claimed and filled in, never freed, so lookups never lock: a
+//writer claims an empty slot by swapping its key in atomically, then publishes the
+//result. a full table stops taking new results. scalars are cached, arrays and errors
+//aren't, and calls with array args aren't keyed at all.
+//
+//probing the file on every call would cost more than most calls do, so a call is only
+//stored once it was expensive, and a function's calls only looked up once one of them
+//was. that a function is expensive is itself kept in the cache, so later processes
+//look up its calls from their first one on
+
+struct ResultCache;
+
+struct ResultKey
+{
+    uint64_t lo;
+    uint64_t hi;
+};
+
+//slots of a new cache file, 32 bytes each. the file is sparse, so only the pages
+//holding results take up space
+constexpr uint64_t RESULT_CACHE_SLOTS = 1 << 20;
+
+//calls are expensive once they make this many calls, counting themselves
+constexpr uint64_t RESULT_CACHE_MIN_CALLS = 256;
+
+//opens the cache at fileName, creating it with numSlots slots if it doesn't exist.
+//nullptr if it can't be opened or isn't a cache
+ResultCache* open_result_cache(const std::string& fileName, uint64_t numSlots = RESULT_CACHE_SLOTS);
+void close_result_cache(ResultCache* cache);
+
+//the cache calls on this thread go through, see ResultCacheScope
+struct ResultCalls
+{
+    ResultCache* cache = nullptr;
+    uint64_t seed = 0;  //the program's sources and opal's semantics, hashed
+    uint64_t calls = 0; //made through cached_call so far
+};
+
+extern thread_local ResultCalls resultCalls;
+
+//caches the calls made on this thread for as long as it's alive. a null cache turns
+//caching off
+class ResultCacheScope
+{
+    ResultCalls previous;
+
+public:
+    ResultCacheScope(ResultCache* cache, uint64_t sourceHash);
+    ~ResultCacheScope();
+};
+
+//false if a call to func with args can't be cached, because an arg is an array
+bool call_key(Function* func, const Value* args, int32_t numArgs, ResultKey& key);
+//false if func isn't known to be expensive, or key has no result yet
+bool find_call_result(Function* func, const ResultKey& key, Value& result);
+//stores result under key, and that func is expensive
+void store_call_result(Function* func, const ResultKey& key, Value result);
+
+//returns the result of a call to func with args, cached or from eval(). args are only
+//read before eval() is
+template<typename Eval>
+Value cached_call(Function* func, const Value* args, int32_t numArgs, Eval eval)
+{
+    ResultKey key;
+    Value result;
+    const bool keyed = call_key(func, args, numArgs, key);
+    if(keyed && find_call_result(func, key, result))
+        return result;
+
+    const uint64_t first = resultCalls.calls++;
+    result = eval();
+    if(keyed && resultCalls.calls - first >= RESULT_CACHE_MIN_CALLS)
+        store_call_result(func, key, result);
+    return result;
+}
+
+#endif
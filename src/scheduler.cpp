@@ -0,0 +1,169 @@
+#include "scheduler.hpp"
+#include "interpreter.hpp"
+#include "closure.hpp"
+#include <algorithm>
+
+struct OpalJob
+{
+    OpalFunction function;
+    std::vector<OpalValue> args;
+    EvalLimits limits;
+    std::promise<OpalValue> result;
+    std::shared_ptr<std::atomic<bool>> cancelled;
+};
+
+//------------------------------------------------------
+//helper func definitions:
+
+static OpalJob* make_job(const OpalFunction& function, const OpalValue* args, int32_t numArgs, const EvalLimits& limits)
+{
+    OpalJob* job = new OpalJob;
+    job->function = function;
+    job->args.assign(args, args + numArgs);
+    job->limits = limits;
+    job->cancelled = std::make_shared<std::atomic<bool>>(false);
+    job->limits.cancel = job->cancelled.get();
+    return job;
+}
+
+static void run_job(OpalJob* job)
+{
+    try
+    {
+        if(job->cancelled->load(std::memory_order_relaxed))
+            throw new RuntimeErrorBudgetExceeded(RuntimeErrorBudgetExceeded::CANCELLED, job->function.compiled->source->line, 0);
+
+        job->result.set_value(opal_call(job->function, job->args.data(), (int32_t)job->args.size(), job->limits));
+    }
+    catch(...)
+    {
+        //errors are thrown as pointers, but a bad_alloc from the args or frames isn't
+        job->result.set_exception(std::current_exception());
+    }
+
+    delete job;
+}
+
+//------------------------------------------------------
+//scheduler:
+
+OpalScheduler::OpalScheduler(uint32_t numThreads) : nextQueue(0), pending(0), stopping(false)
+{
+    if(numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for(uint32_t i = 0; i < numThreads; i++)
+        queues.emplace_back(new WorkerQueue);
+    for(uint32_t i = 0; i < numThreads; i++)
+        workers.emplace_back(&OpalScheduler::work, this, i);
+}
+
+OpalScheduler::~OpalScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for(std::thread& worker : workers)
+        worker.join();
+}
+
+//pops the oldest job of the worker's own queue, so jobs start in the order they were
+//submitted, or else steals the newest of another's
+OpalJob* OpalScheduler::take_job(size_t worker)
+{
+    for(size_t i = 0; i < queues.size(); i++)
+    {
+        WorkerQueue& queue = *queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.jobs.empty())
+            continue;
+
+        OpalJob* job;
+        if(i == 0)
+        {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+        }
+        else
+        {
+            job = queue.jobs.back();
+            queue.jobs.pop_back();
+        }
+
+        pending--;
+        return job;
+    }
+
+    return nullptr;
+}
+
+void OpalScheduler::work(size_t worker)
+{
+    while(true)
+    {
+        OpalJob* job = take_job(worker);
+        if(job != nullptr)
+        {
+            run_job(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [&] { return pending > 0 || stopping; });
+        if(stopping && pending == 0)
+            return;
+    }
+}
+
+//spreads jobs round robin over the worker queues
+void OpalScheduler::enqueue(std::vector<OpalJob*>& jobs)
+{
+    //counted before they're visible, since a worker may take one as soon as it is
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        pending += jobs.size();
+    }
+
+    size_t first = nextQueue.fetch_add(jobs.size());
+    for(size_t q = 0; q < queues.size() && q < jobs.size(); q++)
+    {
+        WorkerQueue& queue = *queues[(first + q) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for(size_t i = q; i < jobs.size(); i += queues.size())
+            queue.jobs.push_back(jobs[i]);
+    }
+
+    if(jobs.size() == 1)
+        wake.notify_one();
+    else
+        wake.notify_all();
+}
+
+OpalFuture OpalScheduler::submit(const OpalFunction& function, const OpalValue* args, int32_t numArgs, const EvalLimits& limits)
+{
+    OpalFuture future;
+    std::vector<OpalJob*> jobs = {make_job(function, args, numArgs, limits)};
+    future.result = jobs[0]->result.get_future();
+    future.cancelled = jobs[0]->cancelled;
+
+    enqueue(jobs);
+    return future;
+}
+
+std::vector<OpalFuture> OpalScheduler::submit_batch(const OpalFunction& function, const OpalValue* args, int32_t numArgs, size_t numCalls, const EvalLimits& limits)
+{
+    std::vector<OpalFuture> futures(numCalls);
+    std::vector<OpalJob*> jobs(numCalls);
+    for(size_t i = 0; i < numCalls; i++)
+    {
+        jobs[i] = make_job(function, args + i * numArgs, numArgs, limits);
+        futures[i].result = jobs[i]->result.get_future();
+        futures[i].cancelled = jobs[i]->cancelled;
+    }
+
+    enqueue(jobs);
+    return futures;
+}
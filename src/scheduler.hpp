@@ -0,0 +1,82 @@
+#ifndef OPAL_SCHEDULER_H
+#define OPAL_SCHEDULER_H
+
+#include "opal.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------
+//asynchronous evaluation:
+//
+//calls are queued as jobs on a pool of workers, each with its own queue. idle workers
+//steal from the others' queues, so a batch that lands unevenly still keeps every
+//worker busy. evaluation state (value stack, boxes, budget) is thread local, so each
+//worker has its own
+
+struct OpalJob;
+
+//the result of a submitted call. get() rethrows the call's error, a heap allocated
+//std::exception pointer like opal_call's
+class OpalFuture
+{
+    std::future<OpalValue> result;
+    std::shared_ptr<std::atomic<bool>> cancelled;
+
+    friend class OpalScheduler;
+
+public:
+    OpalValue get() { return result.get(); }
+    bool ready() const { return result.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+    void wait() const { result.wait(); }
+
+    //a job that hasn't started is dropped, and a running one stops at its next budget
+    //check. either way get() then throws RuntimeErrorBudgetExceeded. does nothing to a
+    //future no job was submitted for
+    void cancel()
+    {
+        if(cancelled != nullptr)
+            cancelled->store(true, std::memory_order_relaxed);
+    }
+};
+
+class OpalScheduler
+{
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<OpalJob*> jobs;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextQueue;
+
+    //workers sleep while nothing is pending
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> pending;
+    bool stopping;
+
+    OpalJob* take_job(size_t worker);
+    void work(size_t worker);
+    void enqueue(std::vector<OpalJob*>& jobs);
+
+public:
+    //0 threads picks the hardware concurrency
+    OpalScheduler(uint32_t numThreads = 0);
+    //finishes every queued job first
+    ~OpalScheduler();
+
+    //the function's program must outlive the job
+    OpalFuture submit(const OpalFunction& function, const OpalValue* args, int32_t numArgs, const EvalLimits& limits = EvalLimits());
+    //submits numCalls calls at once, the args of each following the last's
+    std::vector<OpalFuture> submit_batch(const OpalFunction& function, const OpalValue* args, int32_t numArgs, size_t numCalls, const EvalLimits& limits = EvalLimits());
+};
+
+#endif
@@ -0,0 +1,25 @@
+#include "static_program.hpp"
+
+//nothing else includes static_program.hpp, so this keeps it building and checks that
+//programs compile and run at compile time the way its docs say they do
+
+//------------------------------------------------------
+//compile time checks:
+
+constexpr auto program = opal_static_compile("fn main of n { n + 10 }");
+static_assert(opal_static_call(program, "main", {OpalValue((int64_t)5)}).i == 15);
+
+//nested calls share the compiler's pending args
+constexpr auto nested = opal_static_compile(
+    "fn add of a b { a + b }\n"
+    "fn main of n { add(add(n, 1), add(2, add(n, -n * 3))) }");
+static_assert(opal_static_call(nested, "main", {OpalValue((int64_t)4)}).i == -1);
+
+constexpr auto fact = opal_static_compile(
+    "fn fact of n {\n"
+    "    1 : n <= 1\n"
+    "    n * fact(n - 1) : otherwise\n"
+    "}");
+static_assert(opal_static_call(fact, "fact", {OpalValue((int64_t)10)}).i == 3628800);
+static_assert(opal_static_call(fact, "fact", {OpalValue(2.5)}).type == OpalValue::FLOAT);
+static_assert(opal_static_find(fact, "main") == -1);
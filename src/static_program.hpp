@@ -0,0 +1,760 @@
+#ifndef OPAL_STATIC_PROGRAM_H
+#define OPAL_STATIC_PROGRAM_H
+
+#include "syntax.hpp"
+#include "token.hpp"
+#include "ast.hpp"
+#include "opal.hpp"
+#include "interpreter.hpp"
+#include <exception>
+#include <initializer_list>
+#include <string>
+#include <math.h>
+#include <stdint.h>
+
+//------------------------------------------------------
+//compile time programs:
+//
+//opal_static_compile lexes and parses source in a constexpr context, with the grammar of
+//lexer.cpp and parser.cpp, into flat tables of expressions with every variable and call
+//already resolved:
+//
+//    constexpr auto program = opal_static_compile("fn main of n { n + 10 }");
+//    static_assert(opal_static_call(program, "main", {OpalValue((int64_t)5)}).i == 15);
+//
+//errors are thrown, which a constant expression can't do, so a constexpr program with
+//a syntax error, an unknown variable or function, or a call with the wrong number of
+//args fails to build. calls can run at compile time, or at runtime on tables the
+//compiler can see through. imports aren't supported. everything here is header only
+
+class StaticCompileError : public std::exception
+{
+    std::string str;
+
+public:
+    StaticCompileError(const char* message, int32_t line, int32_t charIdx) : std::exception()
+    {
+        str = "line " + std::to_string(line) + ":" + std::to_string(charIdx) + " - " + message;
+    }
+
+    const char* what() const noexcept override
+    {
+        return str.c_str();
+    }
+};
+
+//frames live on the native stack, so params are capped
+constexpr int32_t STATIC_MAX_PARAMS = 16;
+
+struct StaticName
+{
+    int32_t begin = 0; //in the program's source
+    int32_t length = 0;
+};
+
+struct StaticToken
+{
+    Token::Type type = Token::EMPTY;
+    int32_t value = 0; //Operator, Separator or int literal
+    double floatLit = 0;
+    StaticName iden;
+    int32_t line = 0;
+    int32_t charIdx = 0;
+};
+
+struct StaticExpression
+{
+    Expression::Type type = Expression::INT_LITERAL;
+    Operator op = ADD;
+    int32_t left = 0;
+    int32_t right = 0;
+
+    int32_t slot = 0;      //VARIABLE
+    int32_t function = 0;  //FUNCTION, resolved once every function is parsed
+    int32_t firstArg = 0;  //FUNCTION, into the program's args
+    int32_t numArgs = 0;
+    StaticName name;
+
+    int32_t intLit = 0;
+    double floatLit = 0;
+
+    int32_t line = 0;
+    int32_t charIdx = 0;
+};
+
+struct StaticArm
+{
+    int32_t body = 0;
+    int32_t guard = 0;
+};
+
+struct StaticFunction
+{
+    StaticName name;
+    int32_t firstParam = 0; //into the program's params
+    int32_t numParams = 0;
+    int32_t firstArm = 0;
+    int32_t numArms = 0;
+    int32_t line = 0;
+};
+
+//every table is sized so that no source of N chars can overflow it: each token takes at
+//least a char and adds at most one expression, except for a minus, which adds two
+template<size_t N>
+struct OpalStaticProgram
+{
+    char source[N] = {};
+
+    StaticExpression exps[2 * N + 1] = {};
+    int32_t numExps = 0;
+    int32_t args[N] = {};
+    int32_t numArgs = 0;
+    StaticArm arms[N] = {};
+    int32_t numArms = 0;
+    StaticName params[N] = {};
+    int32_t numParams = 0;
+    StaticFunction functions[N] = {};
+    int32_t numFunctions = 0;
+
+    constexpr bool name_equals(StaticName a, StaticName b) const
+    {
+        if(a.length != b.length)
+            return false;
+        for(int32_t i = 0; i < a.length; i++)
+            if(source[a.begin + i] != source[b.begin + i])
+                return false;
+        return true;
+    }
+
+    constexpr bool name_equals(StaticName a, const char* b) const
+    {
+        for(int32_t i = 0; i < a.length; i++)
+            if(b[i] != source[a.begin + i])
+                return false;
+        return b[a.length] == '\0';
+    }
+};
+
+//------------------------------------------------------
+//compilation:
+
+template<size_t N>
+class StaticCompiler
+{
+public:
+    OpalStaticProgram<N> program;
+
+private:
+    StaticToken tokens[N + 1] = {};
+    int32_t numTokens = 0;
+    int32_t pos = 0;
+    StaticToken empty;
+
+    //args of the calls being parsed, innermost last, like parser.cpp's prattArgs. every
+    //arg takes a token, so they always fit
+    int32_t pendingArgs[N] = {};
+    int32_t numPendingArgs = 0;
+
+    //lexing:
+    //----------------
+    static constexpr bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r'; }
+    static constexpr bool is_digit(char c) { return c >= '0' && c <= '9'; }
+    static constexpr bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+
+    //length of spelling if source continues with it at cur, else 0
+    constexpr int32_t match(int32_t cur, int32_t end, const char* spelling) const
+    {
+        int32_t length = 0;
+        for(; spelling[length] != '\0'; length++)
+            if(cur + length >= end || program.source[cur + length] != spelling[length])
+                return 0;
+        return length;
+    }
+
+    //the longest matching spelling, which is what lex_source finds by trying them
+    //longest first
+    template<size_t COUNT>
+    constexpr int32_t longest_match(int32_t cur, int32_t end, const char* const (&spellings)[COUNT], int32_t& length) const
+    {
+        int32_t best = -1;
+        length = 0;
+        for(int32_t i = 0; i < (int32_t)COUNT; i++)
+        {
+            int32_t matched = match(cur, end, spellings[i]);
+            if(matched > length)
+            {
+                best = i;
+                length = matched;
+            }
+        }
+        return best;
+    }
+
+    constexpr void push_token(StaticToken token)
+    {
+        tokens[numTokens++] = token;
+    }
+
+    constexpr void lex(int32_t end)
+    {
+        int32_t cur = 0;
+        int32_t lineStart = 0;
+        int32_t line = 1;
+
+        while(cur < end)
+        {
+            const char c = program.source[cur];
+            StaticToken token;
+            token.line = line;
+            token.charIdx = cur - lineStart;
+
+            if(c == '\n' || c == '?')
+            {
+                //comments run to the end of the line, which still ends it
+                while(cur < end && program.source[cur] != '\n')
+                    cur++;
+                if(cur >= end)
+                    break;
+
+                if(numTokens > 0 && tokens[numTokens - 1].type != Token::NEWLINE)
+                {
+                    token.type = Token::NEWLINE;
+                    token.charIdx = cur - lineStart;
+                    push_token(token);
+                }
+                cur++;
+                line++;
+                lineStart = cur;
+                continue;
+            }
+
+            if(is_space(c))
+            {
+                cur++;
+                continue;
+            }
+
+            int32_t length = 0;
+            int32_t op = longest_match(cur, end, OPERATOR_SPELLINGS, length);
+            if(op >= 0)
+            {
+                token.type = Token::OPERATOR;
+                token.value = op;
+                push_token(token);
+                cur += length;
+                continue;
+            }
+
+            int32_t sep = longest_match(cur, end, SEPARATOR_SPELLINGS, length);
+            if(sep >= 0)
+            {
+                token.type = Token::SEPARATOR;
+                token.value = sep;
+                push_token(token);
+                cur += length;
+                continue;
+            }
+
+            if(is_digit(c) || c == '.')
+            {
+                //the division is exact, like strtod, while the mantissa fits 53 bits and
+                //there are at most 22 decimals. digits past 18 only scale it
+                uint64_t mantissa = 0;
+                double scale = 1;
+                double dropped = 1;
+                bool isInt = true;
+                int32_t numStart = cur;
+                for(; cur < end && is_digit(program.source[cur]); cur++)
+                {
+                    if(mantissa < 100000000000000000ull)
+                        mantissa = mantissa * 10 + (program.source[cur] - '0');
+                    else
+                        dropped *= 10;
+                }
+                if(cur < end && program.source[cur] == '.')
+                {
+                    isInt = false;
+                    for(cur++; cur < end && is_digit(program.source[cur]); cur++)
+                    {
+                        if(mantissa < 100000000000000000ull)
+                        {
+                            mantissa = mantissa * 10 + (program.source[cur] - '0');
+                            scale *= 10;
+                        }
+                    }
+                }
+
+                if(cur - numStart == 1 && c == '.')
+                    throw new StaticCompileError("invalid token", token.line, token.charIdx);
+
+                if(isInt)
+                {
+                    if(dropped > 1 || mantissa > INT32_MAX)
+                        throw new StaticCompileError("invalid token", token.line, token.charIdx);
+                    token.type = Token::INT_LITERAL;
+                    token.value = (int32_t)mantissa;
+                }
+                else
+                {
+                    token.type = Token::FLOAT_LITERAL;
+                    token.floatLit = (double)mantissa * dropped / scale;
+                }
+                push_token(token);
+                continue;
+            }
+
+            if(!is_alpha(c) && c != '_')
+                throw new StaticCompileError("invalid token", token.line, token.charIdx);
+
+            token.type = Token::IDENTIFIER;
+            token.iden.begin = cur;
+            while(cur < end && (is_alpha(program.source[cur]) || is_digit(program.source[cur]) || program.source[cur] == '_'))
+                cur++;
+            token.iden.length = cur - token.iden.begin;
+            push_token(token);
+        }
+    }
+
+    //token access, as in parser.cpp:
+    //----------------
+    constexpr void remove_newline_tokens()
+    {
+        while(pos < numTokens && tokens[pos].type == Token::NEWLINE)
+            pos++;
+    }
+
+    constexpr const StaticToken& next_token_keep_newline()
+    {
+        if(pos >= numTokens)
+            return empty;
+        return tokens[pos++];
+    }
+
+    constexpr const StaticToken& next_token_skip_newline()
+    {
+        remove_newline_tokens();
+        return next_token_keep_newline();
+    }
+
+    constexpr const StaticToken& next_token(int32_t parenDepth)
+    {
+        return parenDepth == 0 ? next_token_keep_newline() : next_token_skip_newline();
+    }
+
+    constexpr const StaticToken& peek_token(int32_t parenDepth)
+    {
+        int32_t saved = pos;
+        const StaticToken& token = next_token(parenDepth);
+        pos = saved;
+        return token;
+    }
+
+    static constexpr bool is_separator(const StaticToken& token, Separator sep)
+    {
+        return token.type == Token::SEPARATOR && token.value == sep;
+    }
+
+    static constexpr bool is_operator(const StaticToken& token, Operator op)
+    {
+        return token.type == Token::OPERATOR && token.value == op;
+    }
+
+    //parsing:
+    //----------------
+    constexpr int32_t add_exp(StaticExpression exp)
+    {
+        program.exps[program.numExps] = exp;
+        return program.numExps++;
+    }
+
+    constexpr int32_t make_operator(const StaticToken& token, Operator op, int32_t left, int32_t right)
+    {
+        StaticExpression exp;
+        exp.type = Expression::OPERATOR;
+        exp.op = op;
+        exp.left = left;
+        exp.right = right;
+        exp.line = token.line;
+        exp.charIdx = token.charIdx;
+        return add_exp(exp);
+    }
+
+    constexpr int32_t make_operand(const StaticToken& token, const StaticFunction& func)
+    {
+        StaticExpression exp;
+        exp.line = token.line;
+        exp.charIdx = token.charIdx;
+        switch(token.type)
+        {
+        case Token::IDENTIFIER:
+            //the last param with a name shadows earlier ones
+            exp.type = Expression::VARIABLE;
+            exp.slot = -1;
+            for(int32_t i = func.numParams - 1; i >= 0 && exp.slot < 0; i--)
+                if(program.name_equals(program.params[func.firstParam + i], token.iden))
+                    exp.slot = i;
+            if(exp.slot < 0)
+                throw new StaticCompileError("invalid variable", token.line, token.charIdx);
+            break;
+        case Token::INT_LITERAL:
+            exp.type = Expression::INT_LITERAL;
+            exp.intLit = token.value;
+            break;
+        case Token::FLOAT_LITERAL:
+            exp.type = Expression::FLOAT_LITERAL;
+            exp.floatLit = token.floatLit;
+            break;
+        default:
+            throw new StaticCompileError("expected an identifier", token.line, token.charIdx);
+        }
+        return add_exp(exp);
+    }
+
+    //the recursive form of parser.cpp's frame driven pratt parser
+    constexpr int32_t parse_pratt(int32_t minBp, int32_t parenDepth, const StaticFunction& func)
+    {
+        //operand position:
+        const StaticToken& token = next_token(parenDepth);
+        int32_t lhs = 0;
+        if(is_separator(token, OPEN_PAREN))
+        {
+            lhs = parse_pratt(0, parenDepth + 1, func);
+
+            const StaticToken& closeParen = next_token(parenDepth + 1);
+            if(!is_separator(closeParen, CLOSE_PAREN))
+                throw new StaticCompileError("expected a separator", closeParen.line, closeParen.charIdx);
+        }
+        else if(is_operator(token, SUB)) //multiplying by -1
+        {
+            int32_t operand = parse_pratt(PREFIX_BINDING_POWER, parenDepth, func);
+
+            StaticExpression minus1;
+            minus1.type = Expression::INT_LITERAL;
+            minus1.intLit = -1;
+            minus1.line = token.line;
+            minus1.charIdx = token.charIdx;
+            lhs = make_operator(token, MULT, add_exp(minus1), operand);
+        }
+        else if(token.type == Token::IDENTIFIER && is_separator(peek_token(parenDepth), OPEN_PAREN)) //function
+        {
+            next_token(parenDepth);
+
+            const int32_t firstArg = numPendingArgs;
+            if(is_separator(peek_token(parenDepth + 1), CLOSE_PAREN))
+                next_token(parenDepth + 1);
+            else
+            {
+                while(true)
+                {
+                    int32_t arg = parse_pratt(0, parenDepth + 1, func);
+                    pendingArgs[numPendingArgs++] = arg;
+
+                    const StaticToken& sep = next_token(parenDepth + 1);
+                    if(is_separator(sep, COMMA))
+                        continue;
+                    if(!is_separator(sep, CLOSE_PAREN))
+                        throw new StaticCompileError("expected a separator", sep.line, sep.charIdx);
+                    break;
+                }
+            }
+
+            StaticExpression call;
+            call.type = Expression::FUNCTION;
+            call.name = token.iden;
+            call.firstArg = program.numArgs;
+            call.numArgs = numPendingArgs - firstArg;
+            call.line = token.line;
+            call.charIdx = token.charIdx;
+            for(int32_t i = firstArg; i < numPendingArgs; i++)
+                program.args[program.numArgs++] = pendingArgs[i];
+            numPendingArgs = firstArg;
+            lhs = add_exp(call);
+        }
+        else
+            lhs = make_operand(token, func);
+
+        //operator position:
+        while(true)
+        {
+            const StaticToken& op = peek_token(parenDepth);
+            if(op.type == Token::OPERATOR && !is_infix((Operator)op.value))
+                throw new StaticCompileError("expected a separator", op.line, op.charIdx);
+            if(op.type != Token::OPERATOR || binding_power((Operator)op.value).left < minBp)
+                return lhs;
+
+            next_token(parenDepth);
+            int32_t rhs = parse_pratt(binding_power((Operator)op.value).right, parenDepth, func);
+            lhs = make_operator(op, (Operator)op.value, lhs, rhs);
+        }
+    }
+
+    constexpr int32_t parse_expression(const StaticFunction& func)
+    {
+        remove_newline_tokens();
+
+        const StaticToken& first = peek_token(0);
+        if(is_operator(first, OTHERWISE))
+        {
+            pos++;
+            return make_operator(first, OTHERWISE, 0, 0);
+        }
+
+        return parse_pratt(0, 0, func);
+    }
+
+    constexpr void add_arm(StaticFunction& func, int32_t body, int32_t guard)
+    {
+        program.arms[program.numArms++] = {body, guard};
+        func.numArms++;
+    }
+
+    constexpr void parse_function_body(StaticFunction& func)
+    {
+        func.firstArm = program.numArms;
+
+        int32_t firstExp = parse_expression(func);
+        const StaticToken& firstExpEnd = next_token_skip_newline();
+        if(is_separator(firstExpEnd, CLOSE_CURLY)) //single case function
+            add_arm(func, firstExp, make_operator(firstExpEnd, OTHERWISE, 0, 0));
+        else if(is_separator(firstExpEnd, COLON)) //multi case function
+        {
+            add_arm(func, firstExp, parse_expression(func));
+
+            const StaticToken* end = &next_token_skip_newline();
+            while(!is_separator(*end, CLOSE_CURLY))
+            {
+                pos--;
+                int32_t exp = parse_expression(func);
+
+                const StaticToken& colon = next_token_skip_newline();
+                if(!is_separator(colon, COLON))
+                    throw new StaticCompileError("expected a separator", colon.line, colon.charIdx);
+
+                add_arm(func, exp, parse_expression(func));
+                end = &next_token_skip_newline();
+            }
+        }
+        else
+            throw new StaticCompileError("expected a separator", firstExpEnd.line, firstExpEnd.charIdx);
+    }
+
+    constexpr int32_t find_function(StaticName name) const
+    {
+        for(int32_t i = 0; i < program.numFunctions; i++)
+            if(program.name_equals(program.functions[i].name, name))
+                return i;
+        return -1;
+    }
+
+    constexpr void parse_function()
+    {
+        StaticFunction func;
+
+        const StaticToken& declare = next_token_skip_newline();
+        if(is_operator(declare, IMPORT))
+            throw new StaticCompileError("imports aren't supported", declare.line, declare.charIdx);
+        if(!is_operator(declare, FN))
+            throw new StaticCompileError("expected a function", declare.line, declare.charIdx);
+        func.line = declare.line;
+
+        const StaticToken& name = next_token_skip_newline();
+        if(name.type != Token::IDENTIFIER)
+            throw new StaticCompileError("expected an identifier", name.line, name.charIdx);
+        if(find_function(name.iden) >= 0)
+            throw new StaticCompileError("function redefined", name.line, name.charIdx);
+        func.name = name.iden;
+
+        func.firstParam = program.numParams;
+        const StaticToken& of = next_token_skip_newline();
+        if(is_operator(of, OF))
+        {
+            const StaticToken* param = &next_token_skip_newline();
+            while(param->type == Token::IDENTIFIER)
+            {
+                if(func.numParams == STATIC_MAX_PARAMS)
+                    throw new StaticCompileError("too many params", param->line, param->charIdx);
+
+                program.params[program.numParams++] = param->iden;
+                func.numParams++;
+                param = &next_token_skip_newline();
+            }
+        }
+        pos--;
+
+        const StaticToken& openBrace = next_token_skip_newline();
+        if(!is_separator(openBrace, OPEN_CURLY))
+            throw new StaticCompileError("expected a separator", openBrace.line, openBrace.charIdx);
+
+        parse_function_body(func);
+        program.functions[program.numFunctions++] = func;
+    }
+
+    //calls are resolved once every function is known
+    constexpr void link()
+    {
+        for(int32_t i = 0; i < program.numExps; i++)
+        {
+            StaticExpression& exp = program.exps[i];
+            if(exp.type != Expression::FUNCTION)
+                continue;
+
+            exp.function = find_function(exp.name);
+            if(exp.function < 0)
+                throw new StaticCompileError("no function found", exp.line, exp.charIdx);
+            if(program.functions[exp.function].numParams != exp.numArgs)
+                throw new StaticCompileError("wrong number of arguments", exp.line, exp.charIdx);
+        }
+    }
+
+public:
+    constexpr StaticCompiler(const char (&source)[N])
+    {
+        for(size_t i = 0; i < N; i++)
+            program.source[i] = source[i];
+
+        lex((int32_t)N - 1); //without the terminator
+
+        remove_newline_tokens();
+        while(pos < numTokens)
+        {
+            parse_function();
+            remove_newline_tokens();
+        }
+
+        link();
+    }
+};
+
+template<size_t N>
+constexpr OpalStaticProgram<N> opal_static_compile(const char (&source)[N])
+{
+    return StaticCompiler<N>(source).program;
+}
+
+//------------------------------------------------------
+//evaluation, with the semantics of Value:
+
+constexpr double static_scalar(const OpalValue& value)
+{
+    return value.type == OpalValue::FLOAT ? value.f : value.type == OpalValue::BOOL ? (double)value.b : (double)value.i;
+}
+
+constexpr int64_t static_int(const OpalValue& value)
+{
+    if(value.type == OpalValue::FLOAT)
+    {
+        int64_t truncated = (int64_t)value.f;
+        return (double)truncated > value.f ? truncated - 1 : truncated;
+    }
+    return value.type == OpalValue::BOOL ? (int64_t)value.b : value.i;
+}
+
+constexpr OpalValue static_apply(Operator op, const OpalValue& l, const OpalValue& r)
+{
+    const bool isFloat = l.type == OpalValue::FLOAT || r.type == OpalValue::FLOAT;
+    const double lf = static_scalar(l);
+    const double rf = static_scalar(r);
+    const int64_t li = static_int(l);
+    const int64_t ri = static_int(r);
+
+    switch(op)
+    {
+    case ADD:       return isFloat ? OpalValue(lf + rf) : OpalValue((int64_t)((uint64_t)li + (uint64_t)ri));
+    case SUB:       return isFloat ? OpalValue(lf - rf) : OpalValue((int64_t)((uint64_t)li - (uint64_t)ri));
+    case MULT:      return isFloat ? OpalValue(lf * rf) : OpalValue((int64_t)((uint64_t)li * (uint64_t)ri));
+    case DIV:       return isFloat ? OpalValue(lf / rf) : OpalValue(li / ri);
+    case MOD:       return isFloat ? OpalValue(fmod(lf, rf)) : OpalValue(li % ri);
+    case EQUALITY:  return isFloat ? OpalValue(lf == rf) : OpalValue(li == ri);
+    case GREATER:   return isFloat ? OpalValue(lf > rf) : OpalValue(li > ri);
+    case LESS:      return isFloat ? OpalValue(lf < rf) : OpalValue(li < ri);
+    case GREATEREQ: return isFloat ? OpalValue(lf >= rf) : OpalValue(li >= ri);
+    case LESSEQ:    return isFloat ? OpalValue(lf <= rf) : OpalValue(li <= ri);
+    case EXP:
+    {
+        if(isFloat)
+            return OpalValue(pow(lf, rf));
+
+        uint64_t result = 1;
+        for(int64_t i = 0; i < ri; i++)
+            result *= (uint64_t)li;
+        return OpalValue((int64_t)result);
+    }
+    case OTHERWISE: return OpalValue(true);
+    default:        throw new RuntimeErrorInvalidOperator(0, 0);
+    }
+}
+
+template<size_t N>
+constexpr OpalValue static_call_function(const OpalStaticProgram<N>& program, int32_t function, const OpalValue* args);
+
+template<size_t N>
+constexpr OpalValue static_evaluate(const OpalStaticProgram<N>& program, int32_t handle, const OpalValue* frame)
+{
+    const StaticExpression& exp = program.exps[handle];
+    switch(exp.type)
+    {
+    case Expression::OPERATOR:
+        if(exp.op == OTHERWISE)
+            return OpalValue(true);
+        return static_apply(exp.op, static_evaluate(program, exp.left, frame), static_evaluate(program, exp.right, frame));
+    case Expression::FUNCTION:
+    {
+        OpalValue args[STATIC_MAX_PARAMS] = {};
+        for(int32_t i = 0; i < exp.numArgs; i++)
+            args[i] = static_evaluate(program, program.args[exp.firstArg + i], frame);
+        return static_call_function(program, exp.function, args);
+    }
+    case Expression::VARIABLE:
+        return frame[exp.slot];
+    case Expression::INT_LITERAL:
+        return OpalValue((int64_t)exp.intLit);
+    case Expression::FLOAT_LITERAL:
+        return OpalValue(exp.floatLit);
+    default:
+        throw new RuntimeErrorInvalidExpression(exp.line, exp.charIdx);
+    }
+}
+
+template<size_t N>
+constexpr OpalValue static_call_function(const OpalStaticProgram<N>& program, int32_t function, const OpalValue* args)
+{
+    const StaticFunction& func = program.functions[function];
+    for(int32_t i = func.firstArm; i < func.firstArm + func.numArms; i++)
+    {
+        OpalValue condResult = static_evaluate(program, program.arms[i].guard, args);
+        if(condResult.type != OpalValue::BOOL)
+            throw new RuntimeErrorInvalidCondition(program.exps[program.arms[i].guard].line, program.exps[program.arms[i].guard].charIdx);
+
+        if(condResult.b)
+            return static_evaluate(program, program.arms[i].body, args);
+    }
+
+    return OpalValue((int64_t)0);
+}
+
+//index of the function called name, -1 if there's none
+template<size_t N>
+constexpr int32_t opal_static_find(const OpalStaticProgram<N>& program, const char* name)
+{
+    for(int32_t i = 0; i < program.numFunctions; i++)
+        if(program.name_equals(program.functions[i].name, name))
+            return i;
+    return -1;
+}
+
+template<size_t N>
+constexpr OpalValue opal_static_call(const OpalStaticProgram<N>& program, const char* name, std::initializer_list<OpalValue> args)
+{
+    int32_t function = opal_static_find(program, name);
+    if(function < 0)
+        throw new RuntimeErrorFuncNotFound(name, 0, 0);
+    if((size_t)program.functions[function].numParams != args.size())
+        throw new RuntimeErrorIncorrectNumArgs(name, (int32_t)args.size(), program.functions[function].line, 0);
+
+    OpalValue frame[STATIC_MAX_PARAMS] = {};
+    for(size_t i = 0; i < args.size(); i++)
+        frame[i] = args.begin()[i];
+    return static_call_function(program, function, frame);
+}
+
+#endif
@@ -0,0 +1,72 @@
+#include "stats.hpp"
+
+Stats globalStats = {};
+thread_local EvalStats evalStats;
+
+static const char* STAGE_NAMES[NUM_STAGES] = {
+    "load",
+    "run"
+};
+
+static const char* OPERATOR_NAMES[IMPORT + 1] = {
+    "ADD",
+    "SUB",
+    "MULT",
+    "DIV",
+    "MOD",
+    "EQUALITY",
+    "GREATER",
+    "LESS",
+    "GREATEREQ",
+    "LESSEQ",
+    "EXP",
+    "FN",
+    "OF",
+    "OTHERWISE",
+    "IMPORT"
+};
+
+void flush_eval_stats()
+{
+    globalStats.calls += evalStats.calls;
+    for(int32_t i = 0; i <= IMPORT; i++)
+        globalStats.operators[i] += evalStats.operators[i];
+
+    uint64_t maxDepth = globalStats.maxDepth;
+    while(evalStats.maxDepth > maxDepth && !globalStats.maxDepth.compare_exchange_weak(maxDepth, evalStats.maxDepth));
+
+    evalStats = EvalStats();
+}
+
+std::string stats_json()
+{
+    if(!OPAL_STATS)
+        return "{\"enabled\":false}";
+
+    std::string json = "{\"enabled\":true,\"stages\":{";
+    for(int32_t i = 0; i < NUM_STAGES; i++)
+    {
+        if(i > 0)
+            json += ",";
+        json += "\"" + std::string(STAGE_NAMES[i]) + "\":{\"seconds\":" + std::to_string(globalStats.stageNanos[i] / 1e9) + "}";
+    }
+
+    json += "},\"tokens\":" + std::to_string(globalStats.tokens);
+    json += ",\"expressions\":" + std::to_string(globalStats.expressions);
+    json += ",\"calls\":" + std::to_string(globalStats.calls);
+    json += ",\"operators\":{";
+
+    bool first = true;
+    for(int32_t i = 0; i <= IMPORT; i++)
+    {
+        if(!is_infix((Operator)i) && i != OTHERWISE)
+            continue;
+        if(!first)
+            json += ",";
+        json += "\"" + std::string(OPERATOR_NAMES[i]) + "\":" + std::to_string(globalStats.operators[i]);
+        first = false;
+    }
+
+    json += "},\"max_depth\":" + std::to_string(globalStats.maxDepth) + "}";
+    return json;
+}
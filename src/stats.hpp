@@ -0,0 +1,102 @@
+#ifndef OPAL_STATS_H
+#define OPAL_STATS_H
+
+#include "syntax.hpp"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stdint.h>
+
+//set by the build; without it every counter and timer below compiles to nothing
+#ifndef OPAL_STATS
+#define OPAL_STATS 0
+#endif
+
+//wall time of the stages, each timed once by the thread driving it. loading lexes and
+//parses a program's chunks in parallel, streaming tokens into the parser, so it's
+//timed as a whole. functions parsed lazily count towards the run that needed them
+enum Stage
+{
+    STAGE_LOAD,
+    STAGE_RUN,
+
+    NUM_STAGES
+};
+
+//counters shared by every thread. load time counters are added once per lexed or parsed
+//range, so they're cheap to keep atomic
+struct Stats
+{
+    std::atomic<uint64_t> stageNanos[NUM_STAGES];
+    std::atomic<uint64_t> tokens;
+    std::atomic<uint64_t> expressions;
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> operators[IMPORT + 1];
+    std::atomic<uint64_t> maxDepth;
+};
+
+//evaluation counters are bumped per call and operator, so each thread keeps its own
+//and adds them to the shared ones once it's done running
+struct EvalStats
+{
+    uint64_t calls = 0;
+    uint64_t operators[IMPORT + 1] = {};
+    uint64_t depth = 0;
+    uint64_t maxDepth = 0;
+};
+
+extern Stats globalStats;
+extern thread_local EvalStats evalStats;
+
+//adds this thread's evaluation counters to globalStats and resets them
+void flush_eval_stats();
+std::string stats_json();
+
+class StageTimer
+{
+    Stage stage;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    StageTimer(Stage s) : stage(s), start(std::chrono::steady_clock::now()) {}
+    ~StageTimer()
+    {
+        globalStats.stageNanos[stage] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+//tracks the evaluation depth for as long as a call is running
+struct DepthGuard
+{
+    DepthGuard()
+    {
+        if(++evalStats.depth > evalStats.maxDepth)
+            evalStats.maxDepth = evalStats.depth;
+    }
+    ~DepthGuard() { evalStats.depth--; }
+};
+
+//flushes this thread's evaluation counters when leaving the outermost run
+struct EvalStatsScope
+{
+    ~EvalStatsScope() { flush_eval_stats(); }
+};
+
+#define OPAL_STATS_CONCAT_(a, b) a##b
+#define OPAL_STATS_CONCAT(a, b) OPAL_STATS_CONCAT_(a, b)
+
+#if OPAL_STATS
+#define OPAL_STAT_ADD(counter, n) (globalStats.counter += (n))
+#define OPAL_STAT_TIME(stage) StageTimer OPAL_STATS_CONCAT(stageTimer, __LINE__)(stage)
+#define OPAL_EVAL_STAT_INC(counter) (evalStats.counter++)
+#define OPAL_EVAL_STAT_DEPTH() DepthGuard OPAL_STATS_CONCAT(depthGuard, __LINE__)
+#define OPAL_EVAL_STAT_SCOPE() EvalStatsScope OPAL_STATS_CONCAT(evalStatsScope, __LINE__)
+#else
+#define OPAL_STAT_ADD(counter, n) ((void)0)
+#define OPAL_STAT_TIME(stage) ((void)0)
+#define OPAL_EVAL_STAT_INC(counter) ((void)0)
+#define OPAL_EVAL_STAT_DEPTH() ((void)0)
+#define OPAL_EVAL_STAT_SCOPE() ((void)0)
+#endif
+
+#endif
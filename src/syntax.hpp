@@ -1,8 +1,7 @@
 #ifndef OPAL_SYNTAX_H
 #define OPAL_SYNTAX_H
 
-#include <unordered_map>
-#include <string>
+#include <stdint.h>
 
 enum Operator
 {
@@ -19,7 +18,8 @@ enum Operator
     EXP,
     FN,
     OF,
-    OTHERWISE
+    OTHERWISE,
+    IMPORT
 };
 
 enum Separator
@@ -29,47 +29,85 @@ enum Separator
     OPEN_PAREN,
     CLOSE_PAREN,
     COMMA,
-    COLON
+    COLON,
+    OPEN_BRACKET,
+    CLOSE_BRACKET
 };
 
-const std::unordered_map<std::string, Operator> OPERATORS = {
-    {"+", ADD},
-    {"-", SUB},
-    {"*", MULT},
-    {"/", DIV},
-    {"%", MOD},
-    {"=", EQUALITY},
-    {">", GREATER},
-    {"<", LESS},
-    {">=", GREATEREQ},
-    {"<=", LESSEQ},
-    {"^", EXP},
-    {"fn ", FN},
-    {"of ", OF},
-    {"otherwise", OTHERWISE}
+//spelling of every Operator and Separator, indexed by them. keywords include the space
+//that has to follow them
+constexpr const char* OPERATOR_SPELLINGS[] = {
+    "+",         //ADD
+    "-",         //SUB
+    "*",         //MULT
+    "/",         //DIV
+    "%",         //MOD
+    "=",         //EQUALITY
+    ">",         //GREATER
+    "<",         //LESS
+    ">=",        //GREATEREQ
+    "<=",        //LESSEQ
+    "^",         //EXP
+    "fn ",       //FN
+    "of ",       //OF
+    "otherwise", //OTHERWISE
+    "import "    //IMPORT
 };
 
-const std::unordered_map<std::string, Separator> SEPARATORS = {
-    {"{", OPEN_CURLY},
-    {"}", CLOSE_CURLY},
-    {"(", OPEN_PAREN},
-    {")", CLOSE_PAREN},
-    {",", COMMA},
-    {":", COLON}
+constexpr const char* SEPARATOR_SPELLINGS[] = {
+    "{", //OPEN_CURLY
+    "}", //CLOSE_CURLY
+    "(", //OPEN_PAREN
+    ")", //CLOSE_PAREN
+    ",", //COMMA
+    ":", //COLON
+    "[", //OPEN_BRACKET
+    "]"  //CLOSE_BRACKET
 };
 
-const std::unordered_map<Operator, int32_t> ORDER_OF_OPERATIONS = {
-    {ADD, 1},
-    {SUB, 1},
-    {MULT, 2},
-    {DIV, 2},
-    {MOD, 2},
-    {EQUALITY, 0},
-    {GREATER, 0},
-    {LESS, 0},
-    {GREATEREQ, 0},
-    {LESSEQ, 0},
-    {EXP, 3}
+static_assert(sizeof(OPERATOR_SPELLINGS) / sizeof(const char*) == IMPORT + 1, "OPERATOR_SPELLINGS must cover every Operator");
+static_assert(sizeof(SEPARATOR_SPELLINGS) / sizeof(const char*) == CLOSE_BRACKET + 1, "SEPARATOR_SPELLINGS must cover every Separator");
+
+//binding powers used by the expression parser, indexed by Operator.
+//an operator extends an expression while its left power is at least the current minimum;
+//a right power lower than the left one makes the operator right-associative.
+struct BindingPower
+{
+    int32_t left;
+    int32_t right;
 };
 
+constexpr BindingPower ORDER_OF_OPERATIONS[] = {
+    {3, 4},   //ADD
+    {3, 4},   //SUB
+    {5, 6},   //MULT
+    {5, 6},   //DIV
+    {5, 6},   //MOD
+    {1, 2},   //EQUALITY
+    {1, 2},   //GREATER
+    {1, 2},   //LESS
+    {1, 2},   //GREATEREQ
+    {1, 2},   //LESSEQ
+    {8, 7},   //EXP
+    {-1, -1}, //FN
+    {-1, -1}, //OF
+    {-1, -1}, //OTHERWISE
+    {-1, -1}  //IMPORT
+};
+
+static_assert(sizeof(ORDER_OF_OPERATIONS) / sizeof(BindingPower) == IMPORT + 1, "ORDER_OF_OPERATIONS must cover every Operator");
+
+//unary minus only applies to the operand directly after it
+constexpr int32_t PREFIX_BINDING_POWER = 9;
+
+constexpr BindingPower binding_power(Operator op)
+{
+    return ORDER_OF_OPERATIONS[op];
+}
+
+constexpr bool is_infix(Operator op)
+{
+    return ORDER_OF_OPERATIONS[op].left >= 0;
+}
+
 #endif
\ No newline at end of file
@@ -16,7 +16,7 @@ Token::Token(Token::Type type, int32_t intLit, int32_t line, int32_t charIdx) :
     this->intLit = intLit;
 }
 
-Token::Token(Token::Type type, float floatLit, int32_t line, int32_t charIdx) : Token(type, line, charIdx) {
+Token::Token(Token::Type type, double floatLit, int32_t line, int32_t charIdx) : Token(type, line, charIdx) {
     this->floatLit = floatLit;
 }
 
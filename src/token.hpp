@@ -2,8 +2,10 @@
 #define OPAL_TOKEN_H
 
 #include <string>
+#include <vector>
 #include <stdint.h>
 #include "syntax.hpp"
+#include "memory.hpp"
 
 struct Token
 {
@@ -25,7 +27,7 @@ struct Token
 		char* iden;
 		Separator sep;
 		int32_t intLit;
-		float floatLit;
+		double floatLit;
 	};
 
 	int32_t line;
@@ -35,8 +37,10 @@ struct Token
 	Token(Type type, char* iden    , int32_t line, int32_t charIdx);
 	Token(Type type, Separator sep , int32_t line, int32_t charIdx);
 	Token(Type type, int32_t intLit, int32_t line, int32_t charIdx);
-	Token(Type type, float floatLit, int32_t line, int32_t charIdx);
+	Token(Type type, double floatLit, int32_t line, int32_t charIdx);
 	Token(Type type                , int32_t line, int32_t charIdx);
 };
 
+typedef std::vector<Token, TrackedAllocator<Token, MEM_TOKENS>> TokenList;
+
 #endif
\ No newline at end of file
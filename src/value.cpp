@@ -0,0 +1,22 @@
+#include "value.hpp"
+
+thread_local std::vector<int64_t> valueBoxes;
+thread_local std::vector<ArraySpan> valueArrays;
+thread_local std::vector<double, TrackedAllocator<double, MEM_ARRAYS>> arrayElements;
+
+Value release_arrays(const BoxMark& mark, Value result)
+{
+	if(!result.is_array() || (result.bits & Value::PAYLOAD_MASK) < mark.arrays)
+	{
+		valueArrays.resize(mark.arrays);
+		arrayElements.resize(mark.elements);
+		return result;
+	}
+
+	const ArraySpan span = valueArrays[result.bits & Value::PAYLOAD_MASK];
+	memmove(arrayElements.data() + mark.elements, arrayElements.data() + span.begin, span.length * sizeof(double));
+	valueArrays.resize(mark.arrays);
+	valueArrays.push_back({mark.elements, span.length});
+	arrayElements.resize(mark.elements + span.length);
+	return Value::from_bits((Value::TAG_ARRAY << Value::TAG_SHIFT) | mark.arrays);
+}
@@ -0,0 +1,289 @@
+#ifndef OPAL_VALUE_H
+#define OPAL_VALUE_H
+
+#include <vector>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include "memory.hpp"
+
+//------------------------------------------------------
+//boxed integers:
+
+//integers that don't fit a 48 bit payload are spilled here. boxes are released with
+//the call that made them (see release_boxes), so the arena only grows with the depth
+//of live calls, not with the number of big results computed.
+extern thread_local std::vector<int64_t> valueBoxes;
+
+//------------------------------------------------------
+//arrays:
+
+//immutable arrays of doubles live in an arena of elements, in which each array is a
+//run. like boxes, they're released with the call that made them
+struct ArraySpan
+{
+	size_t begin;
+	size_t length;
+};
+
+extern thread_local std::vector<ArraySpan> valueArrays;
+extern thread_local std::vector<double, TrackedAllocator<double, MEM_ARRAYS>> arrayElements;
+
+//------------------------------------------------------
+
+//8 byte nan-boxed value. doubles are stored as they are, with every nan folded into
+//one canonical nan, which leaves the negative quiet nans with a non-zero payload free
+//to tag other types in their top 16 bits.
+struct Value
+{
+	enum Type
+	{
+		INT,
+		FLOAT,
+		BOOL,
+		ARRAY
+	};
+
+	static constexpr int TAG_SHIFT = 48;
+	static constexpr uint64_t TAG_INT = 0xFFF9;
+	static constexpr uint64_t TAG_BOOL = 0xFFFA;
+	static constexpr uint64_t TAG_BOXED_INT = 0xFFFB;
+	static constexpr uint64_t TAG_ARRAY = 0xFFFC;
+
+	static constexpr uint64_t PAYLOAD_MASK = (1ull << TAG_SHIFT) - 1;
+	static constexpr uint64_t CANONICAL_NAN = 0x7FF8000000000000ull;
+	static constexpr int64_t MIN_INLINE_INT = -(1ll << (TAG_SHIFT - 1));
+	static constexpr int64_t MAX_INLINE_INT = (1ll << (TAG_SHIFT - 1)) - 1;
+
+	static constexpr uint64_t EMPTY_BITS = 0xFFFFull << TAG_SHIFT; //unfilled frame slot, never a result
+	static constexpr uint64_t TRUE_BITS = (TAG_BOOL << TAG_SHIFT) | 1;
+	static constexpr uint64_t FALSE_BITS = TAG_BOOL << TAG_SHIFT;
+
+	uint64_t bits;
+
+	Value()          { bits = TAG_INT << TAG_SHIFT; }
+	Value(int64_t i)
+	{
+		if(i >= MIN_INLINE_INT && i <= MAX_INLINE_INT)
+			bits = (TAG_INT << TAG_SHIFT) | ((uint64_t)i & PAYLOAD_MASK);
+		else
+		{
+			bits = (TAG_BOXED_INT << TAG_SHIFT) | valueBoxes.size();
+			valueBoxes.push_back(i);
+		}
+	}
+	Value(double f)
+	{
+		if(f != f)
+			bits = CANONICAL_NAN;
+		else
+			memcpy(&bits, &f, sizeof(bits));
+	}
+	Value(bool b)    { bits = b ? TRUE_BITS : FALSE_BITS; }
+
+	static Value from_bits(uint64_t b) { Value v; v.bits = b; return v; }
+
+	//a new array of length elements, left for the caller to fill. pointers to elements
+	//are only valid until the next array is made
+	static Value new_array(size_t length)
+	{
+		Value v;
+		v.bits = (TAG_ARRAY << TAG_SHIFT) | valueArrays.size();
+		valueArrays.push_back({arrayElements.size(), length});
+		arrayElements.resize(arrayElements.size() + length);
+		return v;
+	}
+
+	//type tests:
+	//----------------
+	uint64_t tag() const    { return bits >> TAG_SHIFT; }
+	bool is_float() const   { return bits < (TAG_INT << TAG_SHIFT); }
+	bool is_int() const     { return tag() == TAG_INT || tag() == TAG_BOXED_INT; }
+	bool is_bool() const    { return tag() == TAG_BOOL; }
+	bool is_true() const    { return bits == TRUE_BITS; }
+	bool is_boxed() const   { return tag() == TAG_BOXED_INT; }
+	bool is_array() const   { return tag() == TAG_ARRAY; }
+
+	Type type() const
+	{
+		if(is_float())
+			return FLOAT;
+		if(is_array())
+			return ARRAY;
+		return is_bool() ? BOOL : INT;
+	}
+
+	//raw accessors, only valid for the matching type:
+	//----------------
+	int64_t as_int() const
+	{
+		if(tag() == TAG_INT)
+			return (int64_t)(bits << (64 - TAG_SHIFT)) >> (64 - TAG_SHIFT);
+		return valueBoxes[bits & PAYLOAD_MASK];
+	}
+	double as_float() const { double f; memcpy(&f, &bits, sizeof(f)); return f; }
+	bool as_bool() const    { return bits & 1; }
+	size_t array_length() const     { return valueArrays[bits & PAYLOAD_MASK].length; }
+	double* array_elements() const  { return arrayElements.data() + valueArrays[bits & PAYLOAD_MASK].begin; }
+
+	//conversions:
+	//----------------
+	double get_scalar() const
+	{
+		if(is_float())
+			return as_float();
+		if(is_bool())
+			return (double)as_bool();
+		return (double)as_int();
+	}
+
+	int64_t get_int() const
+	{
+		if(is_float())
+			return (int64_t)floor(as_float());
+		if(is_bool())
+			return (int64_t)as_bool();
+		return as_int();
+	}
+
+	//operators:
+	//----------------
+	//integer arithmetic wraps around instead of overflowing
+	Value operator+(const Value& other) const
+	{
+		if(is_float() || other.is_float())
+			return Value(get_scalar() + other.get_scalar());
+		else
+			return Value((int64_t)((uint64_t)get_int() + (uint64_t)other.get_int()));
+	}
+
+	Value operator-(const Value& other) const
+	{
+		if(is_float() || other.is_float())
+			return Value(get_scalar() - other.get_scalar());
+		else
+			return Value((int64_t)((uint64_t)get_int() - (uint64_t)other.get_int()));
+	}
+
+	Value operator*(const Value& other) const
+	{
+		if(is_float() || other.is_float())
+			return Value(get_scalar() * other.get_scalar());
+		else
+			return Value((int64_t)((uint64_t)get_int() * (uint64_t)other.get_int()));
+	}
+
+	Value operator/(const Value& other) const
+	{
+		if(is_float() || other.is_float())
+			return Value(get_scalar() / other.get_scalar());
+		else
+			return Value(get_int() / other.get_int());
+	}
+
+	Value operator%(const Value& other) const
+	{
+		if(is_float() || other.is_float())
+			return Value(fmod(get_scalar(), other.get_scalar()));
+		else
+			return Value(get_int() % other.get_int());
+	}
+
+	//integers are compared exactly, anything involving a float as doubles
+	Value operator==(const Value& other) const
+	{
+		if(is_float() || other.is_float())
+			return Value(get_scalar() == other.get_scalar());
+		return Value(get_int() == other.get_int());
+	}
+
+	Value operator>(const Value& other) const
+	{
+		if(is_float() || other.is_float())
+			return Value(get_scalar() > other.get_scalar());
+		return Value(get_int() > other.get_int());
+	}
+
+	Value operator<(const Value& other) const
+	{
+		if(is_float() || other.is_float())
+			return Value(get_scalar() < other.get_scalar());
+		return Value(get_int() < other.get_int());
+	}
+
+	Value operator>=(const Value& other) const
+	{
+		if(is_float() || other.is_float())
+			return Value(get_scalar() >= other.get_scalar());
+		return Value(get_int() >= other.get_int());
+	}
+
+	Value operator<=(const Value& other) const
+	{
+		if(is_float() || other.is_float())
+			return Value(get_scalar() <= other.get_scalar());
+		return Value(get_int() <= other.get_int());
+	}
+
+	Value to(const Value& other) const
+	{
+		if(!is_float() && !other.is_float())
+		{
+			uint64_t result = 1;
+			for(int64_t i = 0; i < other.get_int(); i++)
+				result *= (uint64_t)get_int();
+
+			return Value((int64_t)result);
+		}
+		else
+			return Value(pow(get_scalar(), other.get_scalar()));
+	}
+};
+
+static_assert(sizeof(Value) == 8, "Value must stay 8 bytes");
+
+//argument and temp slots of calls, when they don't fit on the native stack
+typedef std::vector<Value, TrackedAllocator<Value, MEM_FRAMES>> ValueFrames;
+
+//------------------------------------------------------
+//box lifetime:
+
+//tops of the box and array arenas
+struct BoxMark
+{
+	size_t boxes;
+	size_t arrays;
+	size_t elements;
+};
+
+//returns the current tops of the arenas, to be passed to release_boxes
+inline BoxMark mark_boxes()
+{
+	return {valueBoxes.size(), valueArrays.size(), arrayElements.size()};
+}
+
+//frees every array made since mark, moving result's elements down to mark if it was one
+Value release_arrays(const BoxMark& mark, Value result);
+
+//frees every box and array made since mark, moving result's box down to mark if it was
+//one of them
+inline Value release_boxes(const BoxMark& mark, Value result)
+{
+	if(valueArrays.size() != mark.arrays)
+		result = release_arrays(mark, result);
+
+	if(valueBoxes.size() == mark.boxes)
+		return result;
+
+	if(result.is_boxed() && (result.bits & Value::PAYLOAD_MASK) >= mark.boxes)
+	{
+		valueBoxes[mark.boxes] = result.as_int();
+		valueBoxes.resize(mark.boxes + 1);
+		return Value::from_bits((Value::TAG_BOXED_INT << Value::TAG_SHIFT) | mark.boxes);
+	}
+
+	valueBoxes.resize(mark.boxes);
+	return result;
+}
+
+#endif
@@ -0,0 +1,27 @@
+# runs PROGRAM with ARGS with the hot tier off and on, and fails unless both runs
+# give the same result and the hot tier makes no more calls. OPTIONS are passed to
+# both runs. usage:
+#   cmake -DOPAL=<opal> -DPROGRAM=<name> -DARGS=<args> [-DOPTIONS=<options>] -P check_calls.cmake
+
+foreach(hot 0 1)
+    execute_process(COMMAND ${OPAL} ${OPTIONS} --hot-threshold ${hot} --stats ${PROGRAM} ${ARGS}
+                    WORKING_DIRECTORY ${CMAKE_CURRENT_LIST_DIR}
+                    OUTPUT_VARIABLE output ERROR_VARIABLE output RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "hot threshold ${hot}: exited with ${status}\n${output}")
+    endif()
+
+    string(REGEX MATCH "\"calls\":([0-9]+)" unused "${output}")
+    set(calls ${CMAKE_MATCH_1})
+    string(REGEX REPLACE "{[^\n]*}\n?" "" result "${output}")
+    message(STATUS "hot threshold ${hot}: ${calls} calls, result ${result}")
+
+    if(hot EQUAL 0)
+        set(coldResult "${result}")
+        set(coldCalls ${calls})
+    elseif(NOT result STREQUAL coldResult)
+        message(FATAL_ERROR "the hot tier gives ${result}, the tree walker ${coldResult}")
+    elseif(calls GREATER coldCalls)
+        message(FATAL_ERROR "the hot tier makes ${calls} calls, the tree walker ${coldCalls}")
+    endif()
+endforeach()
@@ -0,0 +1,19 @@
+# runs PROGRAM with OPTIONS and ARGS, and INPUT as stdin if given, and fails unless it
+# exits normally and prints something matching EXPECT. usage:
+#   cmake -DOPAL=<opal> -DPROGRAM=<name> -DEXPECT=<regex> [-DOPTIONS=<options>] [-DARGS=<args>] [-DINPUT=<file>] -P check_output.cmake
+
+separate_arguments(options UNIX_COMMAND "${OPTIONS}")
+separate_arguments(args UNIX_COMMAND "${ARGS}")
+if(INPUT)
+    set(input INPUT_FILE ${INPUT})
+endif()
+execute_process(COMMAND ${OPAL} ${options} ${PROGRAM} ${args} ${input}
+                WORKING_DIRECTORY ${CMAKE_CURRENT_LIST_DIR}
+                OUTPUT_VARIABLE output ERROR_VARIABLE output RESULT_VARIABLE status)
+message(STATUS "${output}")
+
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "exited with ${status}")
+elseif(NOT output MATCHES "${EXPECT}")
+    message(FATAL_ERROR "expected output matching \"${EXPECT}\"")
+endif()
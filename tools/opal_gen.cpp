@@ -0,0 +1,229 @@
+//opal_gen: writes synthetic, always terminating opal programs of a configurable shape,
+//for measuring how loading and evaluation scale.
+//
+//the program is a call tree of --functions nodes. node K has an entry function
+//"fK of n acc", which adds the result of its recursive kernel "rK of n acc" to the
+//results of its children (nodes K*fanout+1 .. K*fanout+fanout) called with --steps as
+//their n. a kernel's first arm is the base case, the next arms are guards that never
+//fire, and the last one recurses on n in the chosen pattern. main(n) calls f0(n, 0), so
+//a run makes about functions * steps kernel calls for tail and linear recursion, and
+//functions * fib(steps) for tree recursion.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+
+struct GenOptions
+{
+	uint64_t functions = 100;
+	uint32_t arms = 3;
+	uint32_t depth = 2;
+	uint32_t fanout = 2;
+	uint32_t steps = 10;
+	enum Recursion
+	{
+		TAIL,
+		LINEAR,
+		TREE
+	} recursion = TAIL;
+	uint64_t seed = 1;
+};
+
+//------------------------------------------------------
+//deterministic random numbers (splitmix64), so the same seed gives the same program
+//on every platform:
+
+static uint64_t rngState;
+
+static uint64_t next_random()
+{
+	uint64_t z = (rngState += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+static uint32_t random_below(uint32_t n)
+{
+	return (uint32_t)(next_random() % n);
+}
+
+//------------------------------------------------------
+//program text:
+
+static std::string out;
+
+static void flush_output(FILE* file)
+{
+	fwrite(out.data(), 1, out.size(), file);
+	out.clear();
+}
+
+//a pure expression over n and acc, depth levels deep
+static void write_expression(uint32_t depth)
+{
+	if(depth == 0)
+	{
+		switch(random_below(3))
+		{
+		case 0: out += "n"; break;
+		case 1: out += "acc"; break;
+		case 2: out += std::to_string(random_below(100)); break;
+		}
+		return;
+	}
+
+	static const char* OPS[] = {" + ", " - ", " * ", " % "};
+	uint32_t op = random_below(4);
+
+	out += "(";
+	write_expression(depth - 1);
+	out += OPS[op];
+	if(op == 3) //keep the divisor away from zero
+		out += std::to_string(random_below(100) + 1);
+	else
+		write_expression(depth - 1);
+	out += ")";
+}
+
+static void write_function(const GenOptions& options, uint64_t k)
+{
+	std::string kernel = "r" + std::to_string(k);
+
+	//entry, calling the kernel and the children:
+	//----------------
+	out += "fn f" + std::to_string(k) + " of n acc {\n    " + kernel + "(n, acc)";
+	for(uint64_t c = k * options.fanout + 1; c <= k * options.fanout + options.fanout && c < options.functions; c++)
+		out += " + f" + std::to_string(c) + "(" + std::to_string(options.steps) + ", acc % 97)";
+	out += "\n}\n\n";
+
+	//base arm:
+	//----------------
+	out += "fn " + kernel + " of n acc {\n    acc : n < 1\n";
+
+	//guards that never fire, since n never drops below -1:
+	//----------------
+	for(uint32_t i = 2; i < options.arms; i++)
+	{
+		out += "    ";
+		write_expression(options.depth);
+		out += random_below(2) ? " : n = -" : " : n < -";
+		out += std::to_string(random_below(1000) + 2) + "\n";
+	}
+
+	//recursive arm:
+	//----------------
+	out += "    ";
+	switch(options.recursion)
+	{
+	case GenOptions::TAIL:
+		out += kernel + "(n - 1, (acc + ";
+		write_expression(options.depth);
+		out += ") % 9973)";
+		break;
+	case GenOptions::LINEAR:
+		out += "(";
+		write_expression(options.depth);
+		out += " + " + kernel + "(n - 1, acc)) % 9973";
+		break;
+	case GenOptions::TREE:
+		out += "(" + kernel + "(n - 1, acc) + " + kernel + "(n - 2, ";
+		write_expression(options.depth);
+		out += " % 9973)) % 9973";
+		break;
+	}
+	out += " : otherwise\n}\n\n";
+}
+
+//------------------------------------------------------
+
+static void usage()
+{
+	printf(
+		"usage: opal_gen [options] > program.opal\n"
+		"  --functions N   nodes in the call tree, each an entry and a kernel function (default 100)\n"
+		"  --arms N        guard arms per kernel, at least 2 (default 3)\n"
+		"  --depth N       depth of generated expressions (default 2)\n"
+		"  --fanout N      children called by each node (default 2)\n"
+		"  --steps N       n passed to the children (default 10)\n"
+		"  --recursion R   tail, linear or tree (default tail)\n"
+		"  --seed N        random seed (default 1)\n"
+		"  --output FILE   write to FILE instead of stdout\n");
+}
+
+int main(int argc, char *argv[])
+{
+	GenOptions options;
+	const char* outputName = nullptr;
+
+	for(int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if(strcmp(argv[i], "--functions") == 0 && hasValue)
+			options.functions = strtoull(argv[++i], nullptr, 10);
+		else if(strcmp(argv[i], "--arms") == 0 && hasValue)
+			options.arms = (uint32_t)atoi(argv[++i]);
+		else if(strcmp(argv[i], "--depth") == 0 && hasValue)
+			options.depth = (uint32_t)atoi(argv[++i]);
+		else if(strcmp(argv[i], "--fanout") == 0 && hasValue)
+			options.fanout = (uint32_t)atoi(argv[++i]);
+		else if(strcmp(argv[i], "--steps") == 0 && hasValue)
+			options.steps = (uint32_t)atoi(argv[++i]);
+		else if(strcmp(argv[i], "--seed") == 0 && hasValue)
+			options.seed = strtoull(argv[++i], nullptr, 10);
+		else if(strcmp(argv[i], "--output") == 0 && hasValue)
+			outputName = argv[++i];
+		else if(strcmp(argv[i], "--recursion") == 0 && hasValue)
+		{
+			i++;
+			if(strcmp(argv[i], "tail") == 0)
+				options.recursion = GenOptions::TAIL;
+			else if(strcmp(argv[i], "linear") == 0)
+				options.recursion = GenOptions::LINEAR;
+			else if(strcmp(argv[i], "tree") == 0)
+				options.recursion = GenOptions::TREE;
+			else
+			{
+				usage();
+				return -1;
+			}
+		}
+		else
+		{
+			usage();
+			return -1;
+		}
+	}
+
+	if(options.functions == 0 || options.arms < 2)
+	{
+		usage();
+		return -1;
+	}
+
+	FILE* file = outputName ? fopen(outputName, "wb") : stdout;
+	if(file == nullptr)
+	{
+		printf("can't open \"%s\"\n", outputName);
+		return -1;
+	}
+
+	rngState = options.seed;
+
+	out += "? generated by opal_gen: " + std::to_string(options.functions) + " functions, seed " + std::to_string(options.seed) + "\n\n";
+	out += "fn main of n {\n    f0(n, 0)\n}\n\n";
+	for(uint64_t k = 0; k < options.functions; k++)
+	{
+		write_function(options, k);
+		if(out.size() > (1 << 20))
+			flush_output(file);
+	}
+	flush_output(file);
+
+	if(file != stdout)
+		fclose(file);
+
+	return 0;
+}